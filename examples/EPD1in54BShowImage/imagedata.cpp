@@ -26,7 +26,7 @@
 #include "imagedata.h"
 #if defined(__AVR__) || defined(ARDUINO_ARCH_SAMD)
 #include <avr/pgmspace.h>
-#elif defined(ESP8266) || defined(ESP32)
+#elif defined(ESP8266) || defined(ESP32) || defined(EPD_HOST)
 #include <pgmspace.h>
 #endif
 
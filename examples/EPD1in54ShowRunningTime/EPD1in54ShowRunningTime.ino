@@ -103,10 +103,7 @@ void setup() {
 
   delay(2000);
 
-  if (epd.init(lutPartialUpdate) != 0) {
-    Serial.print("e-Paper init failed");
-    return;
-  }
+  epd.setUpdateMode(EPD_UPDATE_PARTIAL);    // only rewrites the look-up table
 
   /**
    *  there are 2 memory areas embedded in the e-paper display
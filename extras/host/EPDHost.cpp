@@ -0,0 +1,336 @@
+/**
+ *  @filename   :   EPDHost.cpp
+ *  @brief      :   Implements the recording backend and the mocked Arduino API
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "EPDHost.h"
+#include "SPI.h"
+
+#define EPDHOST_PIN_COUNT   256
+
+SPIClass SPI;
+
+struct HostState {
+  unsigned long long now;
+  unsigned long gpioTime;
+  unsigned long spiCallTime;
+  unsigned long byteTime;
+  unsigned int resetPin;
+  unsigned int dcPin;
+  unsigned int csPin;
+  unsigned int busyPin;
+  int busyLevel;
+  unsigned long long busyUntil;
+  unsigned long busyCommands[256];
+  unsigned char pins[EPDHOST_PIN_COUNT];
+  std::vector<EPDHostByte> bytes;
+  unsigned long gpioCount;
+  unsigned long spiCount;
+  unsigned long csErrorCount;
+  bool dmaBusy;
+  unsigned long long dmaEnd;
+  void (*dmaDone)(void*);
+  void* dmaArg;
+};
+
+/**
+ *  @brief: the state before begin(), all zero but the timings and the
+ *          pins of the examples
+ */
+static HostState initialState(void) {
+  HostState state = HostState();
+  state.gpioTime = EPDHOST_GPIO_TIME_NS;
+  state.spiCallTime = EPDHOST_SPI_CALL_TIME_NS;
+  state.byteTime = 4000;
+  state.resetPin = 8;
+  state.dcPin = 9;
+  state.csPin = 10;
+  state.busyPin = 7;
+  state.busyLevel = HIGH;
+  return state;
+}
+
+static HostState host = initialState();
+
+/**
+ *  @brief: set the pins to watch, and the level of the busy pin while
+ *          the module is busy (HIGH for EPD1in54, LOW for EPD1in54B/C).
+ *          this also clears the record and the virtual clock.
+ */
+void EPDHost::begin(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy, int busy_level) {
+  host.resetPin = reset;
+  host.dcPin = dc;
+  host.csPin = cs;
+  host.busyPin = busy;
+  host.busyLevel = busy_level;
+  host.now = 0;
+  host.busyUntil = 0;
+  host.dmaBusy = false;
+  memset(host.pins, HIGH, sizeof(host.pins));
+  clear();
+}
+
+/**
+ *  @brief: forget the recorded bytes and counters
+ */
+void EPDHost::clear(void) {
+  host.bytes.clear();
+  host.gpioCount = 0;
+  host.spiCount = 0;
+  host.csErrorCount = 0;
+}
+
+/**
+ *  @brief: make the busy pin read busy for busy_ms after the command
+ */
+void EPDHost::addBusyCommand(unsigned char command, unsigned long busy_ms) {
+  host.busyCommands[command] = busy_ms;
+}
+
+void EPDHost::setGpioTime(unsigned long ns) {
+  host.gpioTime = ns;
+}
+
+void EPDHost::setSpiCallTime(unsigned long ns) {
+  host.spiCallTime = ns;
+}
+
+unsigned long long EPDHost::nowNs(void) {
+  return host.now;
+}
+
+/**
+ *  @brief: move the virtual clock forward and complete a simulated DMA
+ *          transfer whose time has come
+ */
+void EPDHost::advanceNs(unsigned long long ns) {
+  host.now += ns;
+  serviceDma();
+}
+
+const std::vector<EPDHostByte>& EPDHost::record(void) {
+  return host.bytes;
+}
+
+unsigned long EPDHost::gpioCalls(void) {
+  return host.gpioCount;
+}
+
+unsigned long EPDHost::spiCalls(void) {
+  return host.spiCount;
+}
+
+/**
+ *  @brief: number of bytes sent while the CS pin was HIGH
+ */
+unsigned long EPDHost::csErrors(void) {
+  return host.csErrorCount;
+}
+
+/**
+ *  @brief: compare two records byte for byte, DC level included,
+ *          ignoring the timing
+ */
+bool EPDHost::sameStream(const std::vector<EPDHostByte>& a, const std::vector<EPDHostByte>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); i++) {
+    if (a[i].value != b[i].value || a[i].dc != b[i].dc) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ *  @brief: print the record, one byte per line
+ */
+void EPDHost::dump(FILE* out) {
+  for (size_t i = 0; i < host.bytes.size(); i++) {
+    fprintf(
+            out,
+            "%12.3f us  %c 0x%02X\n",
+            host.bytes[i].timeNs / 1000.0,
+            host.bytes[i].dc == LOW ? 'C' : 'D',
+            host.bytes[i].value
+            );
+  }
+}
+
+/**
+ *  @brief: record a block as if a DMA engine sent it after the bytes
+ *          already on the bus, without moving the virtual clock.
+ *          done is called once the clock passes the end of the block.
+ */
+void EPDHost::queueDma(const unsigned char* data, unsigned int len, void (*done)(void*), void* arg) {
+  unsigned long long start = host.dmaBusy && host.dmaEnd > host.now ? host.dmaEnd : host.now;
+  EPDHostByte sent;
+
+  host.spiCount++;
+  sent.dc = host.pins[host.dcPin];
+  for (unsigned int i = 0; i < len; i++) {
+    start += host.byteTime;
+    sent.timeNs = start;
+    sent.value = data[i];
+    host.bytes.push_back(sent);
+  }
+  host.dmaEnd = start;
+  host.dmaDone = done;
+  host.dmaArg = arg;
+  host.dmaBusy = true;
+}
+
+bool EPDHost::isDmaBusy(void) {
+  return host.dmaBusy;
+}
+
+/**
+ *  @brief: wait for the simulated DMA transfer, moving the clock to its end
+ */
+void EPDHost::finishDma(void) {
+  if (!host.dmaBusy) {
+    return;
+  }
+  if (host.now < host.dmaEnd) {
+    host.now = host.dmaEnd;
+  }
+  serviceDma();
+}
+
+/**
+ *  @brief: complete the simulated DMA transfer if its end has passed
+ */
+void EPDHost::serviceDma(void) {
+  if (host.dmaBusy && host.now >= host.dmaEnd) {
+    host.dmaBusy = false;
+    if (host.dmaDone != NULL) {
+      host.dmaDone(host.dmaArg);
+    }
+  }
+}
+
+void EPDHost::setClock(unsigned long clock) {
+  if (clock > 0) {
+    host.byteTime = 8000000000ULL / clock;
+  }
+}
+
+void EPDHost::sendByte(unsigned char value) {
+  EPDHostByte sent;
+  host.now += host.byteTime;
+  if (host.pins[host.csPin] != LOW) {
+    host.csErrorCount++;
+  }
+  sent.timeNs = host.now;
+  sent.value = value;
+  sent.dc = host.pins[host.dcPin];
+  host.bytes.push_back(sent);
+  if (sent.dc == LOW && host.busyCommands[value] > 0) {
+    host.busyUntil = host.now + host.busyCommands[value] * 1000000ULL;
+  }
+}
+
+void EPDHost::writePin(unsigned int pin, int level) {
+  host.gpioCount++;
+  host.now += host.gpioTime;
+  if (pin < EPDHOST_PIN_COUNT) {
+    host.pins[pin] = level;
+  }
+}
+
+int EPDHost::readPin(unsigned int pin) {
+  host.gpioCount++;
+  host.now += host.gpioTime;
+  if (pin == host.busyPin) {
+    return host.now < host.busyUntil ? host.busyLevel : !host.busyLevel;
+  }
+  return pin < EPDHOST_PIN_COUNT ? host.pins[pin] : LOW;
+}
+
+/* Arduino API */
+
+void pinMode(uint8_t, uint8_t) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  EPDHost::writePin(pin, val);
+}
+
+int digitalRead(uint8_t pin) {
+  return EPDHost::readPin(pin);
+}
+
+void delay(unsigned long ms) {
+  EPDHost::advanceNs(ms * 1000000ULL);
+}
+
+void delayMicroseconds(unsigned int us) {
+  EPDHost::advanceNs(us * 1000ULL);
+}
+
+unsigned long millis(void) {
+  EPDHost::advanceNs(EPDHOST_CLOCK_READ_TIME_NS);
+  return (unsigned long) (EPDHost::nowNs() / 1000000ULL);
+}
+
+unsigned long micros(void) {
+  EPDHost::advanceNs(EPDHOST_CLOCK_READ_TIME_NS);
+  return (unsigned long) (EPDHost::nowNs() / 1000ULL);
+}
+
+void yield(void) {
+  EPDHost::advanceNs(EPDHOST_CLOCK_READ_TIME_NS);
+}
+
+/* SPI library */
+
+void SPIClass::begin(void) {
+}
+
+void SPIClass::end(void) {
+}
+
+void SPIClass::beginTransaction(SPISettings settings) {
+  EPDHost::setClock(settings.clock);
+}
+
+void SPIClass::endTransaction(void) {
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+  host.spiCount++;
+  host.now += host.spiCallTime;
+  EPDHost::sendByte(data);
+  return 0;
+}
+
+void SPIClass::transfer(void* buf, size_t count) {
+  unsigned char* bytes = (unsigned char*) buf;
+  host.spiCount++;
+  host.now += host.spiCallTime;
+  for (size_t i = 0; i < count; i++) {
+    EPDHost::sendByte(bytes[i]);
+    bytes[i] = 0;
+  }
+}
+
+/* END OF FILE */
@@ -0,0 +1,92 @@
+/**
+ *  @filename   :   EPDHost.h
+ *  @brief      :   Recording backend for building and measuring the library on a Linux host.
+ *                  build the sources with -DEPD_HOST and this directory on the include
+ *                  path, together with EPDHost.cpp, see README.md.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef EPDHOST_H
+#define EPDHOST_H
+
+#include <stdio.h>
+#include <vector>
+#include "Arduino.h"
+
+// Default virtual cost of the mocked calls
+#define EPDHOST_GPIO_TIME_NS        500
+#define EPDHOST_SPI_CALL_TIME_NS    1000
+#define EPDHOST_CLOCK_READ_TIME_NS  100
+
+/* one byte seen on the SPI bus */
+struct EPDHostByte {
+  unsigned long long timeNs;      // virtual time when the byte was sent
+  unsigned char value;
+  unsigned char dc;               // DC pin level, LOW: command, HIGH: data
+};
+
+/**
+ *  The mock keeps a virtual clock. The clock advances by the wire time of
+ *  every byte at the current SPI clock, by the configured cost of every
+ *  GPIO and SPI call, and by delay()/delayMicroseconds(). millis() and
+ *  micros() read it. Every byte is recorded with its DC level and time.
+ *
+ *  The busy pin is driven by a simple model: commands registered with
+ *  addBusyCommand() hold it at the busy level for the given time.
+ */
+class EPDHost {
+ public:
+  static void begin(
+                    unsigned int reset = 8,
+                    unsigned int dc = 9,
+                    unsigned int cs = 10,
+                    unsigned int busy = 7,
+                    int busy_level = HIGH
+                    );
+  static void clear(void);
+  static void addBusyCommand(unsigned char command, unsigned long busy_ms);
+  static void setGpioTime(unsigned long ns);
+  static void setSpiCallTime(unsigned long ns);
+  static unsigned long long nowNs(void);
+  static void advanceNs(unsigned long long ns);
+
+  static const std::vector<EPDHostByte>& record(void);
+  static unsigned long gpioCalls(void);
+  static unsigned long spiCalls(void);
+  static unsigned long csErrors(void);
+  static bool sameStream(const std::vector<EPDHostByte>& a, const std::vector<EPDHostByte>& b);
+  static void dump(FILE* out);
+
+  /* simulated DMA, used by EPDIF::spiTransferBufferAsync() */
+  static void queueDma(const unsigned char* data, unsigned int len, void (*done)(void*), void* arg);
+  static bool isDmaBusy(void);
+  static void finishDma(void);
+  static void serviceDma(void);
+
+  /* used by the mocked Arduino API */
+  static void setClock(unsigned long clock);
+  static void sendByte(unsigned char value);
+  static void writePin(unsigned int pin, int level);
+  static int  readPin(unsigned int pin);
+};
+
+#endif
+
+/* END OF FILE */
@@ -0,0 +1,37 @@
+/**
+ *  @filename   :   pgmspace.h
+ *  @brief      :   PROGMEM helpers for the host build, see EPDHost.h
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef EPDHOST_PGMSPACE_H
+#define EPDHOST_PGMSPACE_H
+
+#include <string.h>
+
+/* a host has a single address space, so flash data is plain memory */
+#define PROGMEM
+#define pgm_read_byte(addr)     (*(const unsigned char*)(addr))
+#define pgm_read_word(addr)     (*(const unsigned short*)(addr))
+#define memcpy_P                memcpy
+
+#endif
+
+/* END OF FILE */
@@ -0,0 +1,123 @@
+/**
+ *  @filename   :   EPDCommitTest.cpp
+ *  @brief      :   Checks EPD1in54::commitFrame() against both RAM banks of a
+ *                  modelled controller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EPDHost.h>
+#include <EPD1in54.h>
+#include "EPDRamModel.h"
+
+static EPDRamModel ram;
+static unsigned char frame[EPDRAMMODEL_BYTES];
+static unsigned char previous[EPDRAMMODEL_BYTES];
+
+/* a few random rectangles of random bytes */
+static void change(void) {
+  for (int k = rand() % 4; k >= 0; k--) {
+    int x = rand() % EPDRAMMODEL_LINE_BYTES;
+    int y = rand() % EPD_HEIGHT;
+    int width = 1 + rand() % 6;
+    int height = 1 + rand() % 40;
+    for (int j = y; j < y + height && j < EPD_HEIGHT; j++) {
+      for (int i = x; i < x + width && i < EPDRAMMODEL_LINE_BYTES; i++) {
+        frame[j * EPDRAMMODEL_LINE_BYTES + i] = rand();
+      }
+    }
+  }
+}
+
+/* after a commit both banks hold the frame and the one before it */
+static int commit(EPD1in54& epd) {
+  int written = ram.getWriteBank();
+  int errors = 0;
+
+  epd.commitFrame(frame);
+  ram.feed();
+  if (memcmp(ram.bank(written), frame, EPDRAMMODEL_BYTES) != 0) {
+    errors++;
+  }
+  if (memcmp(ram.shown(), frame, EPDRAMMODEL_BYTES) != 0) {
+    errors++;
+  }
+  if (memcmp(ram.bank(written ^ 1), previous, EPDRAMMODEL_BYTES) != 0) {
+    errors++;
+  }
+  memcpy(previous, frame, EPDRAMMODEL_BYTES);
+  return errors;
+}
+
+/**
+ *  the first two commits after init() go to a RAM of garbage, through a
+ *  shadow that is all 0 (not what either bank holds), with a frame whose
+ *  top half is all 0 too: both have to send the whole frame
+ */
+static int checkFirst(EPD1in54& epd) {
+  static unsigned char shadow[EPDRAMMODEL_BYTES];
+  static unsigned long tiles[EPD_DIFF_TILE_WORDS];
+  int errors = 0;
+
+  epd.init(lutFullUpdate);
+  ram.reset(0);
+  ram.scramble();
+  memset(shadow, 0, sizeof(shadow));
+  epd.setFrameShadow(shadow, tiles);
+  memset(frame, 0x00, EPDRAMMODEL_BYTES / 2);
+  memset(frame + EPDRAMMODEL_BYTES / 2, 0xFF, EPDRAMMODEL_BYTES / 2);
+  epd.commitFrame(frame);
+  ram.feed();
+  errors += memcmp(ram.bank(0), frame, EPDRAMMODEL_BYTES) != 0;
+  errors += ram.takeWritten(0) != EPDRAMMODEL_BYTES;
+  epd.commitFrame(frame);
+  ram.feed();
+  errors += memcmp(ram.bank(1), frame, EPDRAMMODEL_BYTES) != 0;
+  errors += ram.takeWritten(1) != EPDRAMMODEL_BYTES;
+  memcpy(previous, frame, EPDRAMMODEL_BYTES);
+  return errors;
+}
+
+int main(void) {
+  EPD1in54 epd;
+  int errors = 0;
+
+  srand(1);
+  EPDHost::begin();
+  EPDHost::addBusyCommand(MASTER_ACTIVATION, 300);
+  errors += checkFirst(epd);
+  for (int step = 0; step < 100; step++) {
+    change();
+    errors += commit(epd);
+  }
+  /* the banks are unknown again after sleep() and init() */
+  epd.sleep();
+  errors += checkFirst(epd);
+  for (int step = 0; step < 100; step++) {
+    change();
+    errors += commit(epd);
+  }
+  printf("EPDCommitTest: %d checks failed\n", errors);
+  return errors == 0 ? 0 : 1;
+}
+
+/* END OF FILE */
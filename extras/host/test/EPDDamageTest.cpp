@@ -0,0 +1,177 @@
+/**
+ *  @filename   :   EPDDamageTest.cpp
+ *  @brief      :   Checks EPD1in54::setFrameMemoryDamage() against the RAM of a
+ *                  modelled controller, with and without a band
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EPDHost.h>
+#include <EPD1in54.h>
+#include <EPDPaint.h>
+
+#define LINE_BYTES      (EPD_WIDTH / 8)
+#define BAND_ROWS       24
+
+/* the frame memory of the controller, written by the recorded bytes */
+static unsigned char ram[LINE_BYTES * EPD_HEIGHT];
+static int xStart, xEnd, yStart, yEnd, xCounter, yCounter, command;
+static unsigned int argCount;
+
+static void feedRam(void) {
+  const std::vector<EPDHostByte>& record = EPDHost::record();
+  static unsigned char args[4];
+  for (size_t i = 0; i < record.size(); i++) {
+    unsigned char value = record[i].value;
+    if (!record[i].dc) {
+      command = value;
+      argCount = 0;
+      continue;
+    }
+    if (argCount < sizeof(args)) {
+      args[argCount] = value;
+    }
+    argCount++;
+    if (command == SET_RAM_X_ADDRESS_START_END_POSITION && argCount == 2) {
+      xStart = args[0];
+      xEnd = args[1];
+    } else if (command == SET_RAM_Y_ADDRESS_START_END_POSITION && argCount == 4) {
+      yStart = args[0] | args[1] << 8;
+      yEnd = args[2] | args[3] << 8;
+    } else if (command == SET_RAM_X_ADDRESS_COUNTER && argCount == 1) {
+      xCounter = args[0];
+    } else if (command == SET_RAM_Y_ADDRESS_COUNTER && argCount == 2) {
+      yCounter = args[0] | args[1] << 8;
+    } else if (command == WRITE_RAM) {
+      ram[yCounter * LINE_BYTES + xCounter] = value;
+      if (++xCounter > xEnd) {
+        xCounter = xStart;
+        if (++yCounter > yEnd) {
+          yCounter = yStart;
+        }
+      }
+    }
+  }
+  EPDHost::clear();
+}
+
+static sFONT* fonts[] = {&Font8, &Font12, &Font16, &Font20, &Font24};
+
+/* a few random drawing calls, the same on every paint given the seed */
+static void draw(EPDPaint& paint, unsigned int seed) {
+  int w = paint.getWidth();
+  int h = paint.getHeight();
+  srand(seed);
+  for (int k = rand() % 4; k >= 0; k--) {
+    int x = rand() % w - 8;
+    int y = rand() % h - 8;
+    int colored = rand() & 1;
+    switch (rand() % 4) {
+      case 0:
+        paint.drawStringAt(x, y, "12:34", fonts[rand() % 5], colored);
+        break;
+      case 1:
+        paint.drawFilledRectangle(x, y, x + rand() % 40, y + rand() % 40, colored);
+        break;
+      case 2:
+        paint.drawLine(x, y, rand() % w, rand() % h, colored);
+        break;
+      default:
+        paint.drawCircle(x, y, rand() % 20, colored);
+        break;
+    }
+  }
+}
+
+/* a paint at x, y that sends its damage after every few calls */
+static int checkWindow(EPD1in54& epd, int x, int y, int width, int height, int rotate) {
+  static unsigned char image[LINE_BYTES * EPD_HEIGHT];
+  EPDPaint paint(image, width, height);
+  int errors = 0;
+
+  paint.setRotate(rotate);
+  paint.clear(1);
+  epd.setFrameMemory(image, x, y, width, height);
+  paint.clearDamage();
+  for (int step = 0; step < 200; step++) {
+    draw(paint, step * 4 + rotate);
+    epd.setFrameMemoryDamage(paint, x, y);
+    feedRam();
+    for (int j = 0; j < height && y + j < EPD_HEIGHT; j++) {
+      for (int i = 0; i < width / 8 && x / 8 + i < LINE_BYTES; i++) {
+        if (ram[(y + j) * LINE_BYTES + x / 8 + i] != image[j * (width / 8) + i]) {
+          errors++;
+        }
+      }
+    }
+  }
+  return errors;
+}
+
+/* a paint of the whole display drawn and sent band by band */
+static int checkBands(EPD1in54& epd, int rotate) {
+  static unsigned char frame[LINE_BYTES * EPD_HEIGHT];
+  static unsigned char band_image[LINE_BYTES * BAND_ROWS];
+  EPDPaint whole(frame, EPD_WIDTH, EPD_HEIGHT);
+  EPDPaint band(band_image, EPD_WIDTH, EPD_HEIGHT);
+  int errors = 0;
+
+  whole.setRotate(rotate);
+  band.setRotate(rotate);
+  epd.clearFrameMemory(0xFF);
+  whole.clear(0);
+  for (int step = 0; step < 20; step++) {
+    draw(whole, step);
+  }
+  for (int y = 0; y < EPD_HEIGHT; y += BAND_ROWS) {
+    band.setBand(y, EPD_HEIGHT - y < BAND_ROWS ? EPD_HEIGHT - y : BAND_ROWS);
+    band.clear(0);
+    for (int step = 0; step < 20; step++) {
+      draw(band, step);
+    }
+    epd.setFrameMemoryDamage(band, 0, 0);
+  }
+  feedRam();
+  for (int i = 0; i < LINE_BYTES * EPD_HEIGHT; i++) {
+    if (ram[i] != frame[i]) {
+      errors++;
+    }
+  }
+  return errors;
+}
+
+int main(void) {
+  EPD1in54 epd;
+  int errors = 0;
+
+  EPDHost::begin();
+  epd.init(lutFullUpdate);
+  for (int rotate = ROTATE_0; rotate <= ROTATE_270; rotate++) {
+    errors += checkWindow(epd, 40, 64, 96, 72, rotate);
+    errors += checkWindow(epd, 136, 150, 80, 64, rotate);
+    errors += checkBands(epd, rotate);
+  }
+  printf("EPDDamageTest: %d bytes differ\n", errors);
+  return errors == 0 ? 0 : 1;
+}
+
+/* END OF FILE */
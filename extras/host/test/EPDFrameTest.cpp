@@ -0,0 +1,456 @@
+/**
+ *  @filename   :   EPDFrameTest.cpp
+ *  @brief      :   Checks the ways of EPD1in54 to fill the frame memory against
+ *                  sending whole frames the plain way
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EPDHost.h>
+#include <EPD1in54.h>
+#include <EPDDisplayList.h>
+#include "EPDRamModel.h"
+
+#define WINDOW_BYTES    2000
+#define BATCH_WINDOWS   4
+#define WINDOW_HEADER   40
+
+/* the band heights of the display list uploads */
+static const int bandRows[] = {1, 8, 24, 37, EPD_HEIGHT};
+
+/* the bank scratch sizes */
+static const unsigned int scratchSizes[] = {1200, 2100, 6000};
+
+/* the RAM the calls checked write, and the one of plain full frames */
+static EPDRamModel ram;
+static EPDRamModel plain;
+/* what the frame memory should hold */
+static unsigned char frame[EPDRAMMODEL_BYTES];
+
+/* a random frame, sent whole the plain way, to start a check from */
+static void start(EPD1in54& epd) {
+  for (int i = 0; i < EPDRAMMODEL_BYTES; i++) {
+    frame[i] = rand();
+  }
+  epd.setFrameMemory(frame, 0, 0, EPD_WIDTH, EPD_HEIGHT);
+  ram.feed();
+}
+
+/* puts an image at x, y into frame the way setFrameMemory() clips it */
+static void put(const unsigned char* image, int x, int y, int width, int height) {
+  for (int j = 0; j < height && y + j < EPD_HEIGHT; j++) {
+    for (int i = 0; i < width / 8 && x / 8 + i < EPDRAMMODEL_LINE_BYTES; i++) {
+      frame[(y + j) * EPDRAMMODEL_LINE_BYTES + x / 8 + i] = image[j * (width / 8) + i];
+    }
+  }
+}
+
+/**
+ *  the bank the calls checked wrote, against frame sent whole by
+ *  reference, another driver on the same bus, to a RAM of its own
+ */
+static int compareRam(EPD1in54& reference) {
+  int bank = ram.getWriteBank();
+  ram.feed();
+  reference.setFrameMemory(frame, 0, 0, EPD_WIDTH, EPD_HEIGHT);
+  plain.feed();
+  return memcmp(ram.bank(bank), plain.bank(plain.getWriteBank()), EPDRAMMODEL_BYTES) != 0;
+}
+
+/* a window of setFrameMemoryAsync() and the order it has to finish in */
+struct AsyncWindow {
+  int index;
+  unsigned int bytes;
+};
+
+static int asyncLast;
+static int asyncCount;
+static int asyncErrors;
+
+/* the callback comes after the whole window went out, in order */
+static void asyncSent(void* arg) {
+  AsyncWindow* window = (AsyncWindow*) arg;
+  const std::vector<EPDHostByte>& record = EPDHost::record();
+  size_t i = record.size();
+  unsigned int bytes = 0;
+
+  while (i > 0 && record[i - 1].dc) {
+    i--;
+    bytes++;
+  }
+  if (
+      window->index <= asyncLast || bytes != window->bytes ||
+      i == 0 || record[i - 1].value != WRITE_RAM ||
+      record.back().timeNs > EPDHost::nowNs()
+      ) {
+    asyncErrors++;
+  }
+  asyncLast = window->index;
+  asyncCount++;
+}
+
+/**
+ *  random windows sent by setFrameMemoryAsync(), some of them cut by the
+ *  edge of the display, with a plain setFrameMemory() in between now and
+ *  then. every call waits for the window before, so the two buffers are
+ *  free again when they are reused.
+ */
+static int checkAsync(EPD1in54& epd, EPD1in54& reference) {
+  static unsigned char images[2][WINDOW_BYTES];
+  static AsyncWindow windows[2];
+  int queued = 0;
+  int errors = 0;
+
+  asyncLast = -1;
+  asyncCount = 0;
+  asyncErrors = 0;
+  start(epd);
+  for (int step = 0; step < 200; step++) {
+    unsigned char* image = images[step % 2];
+    AsyncWindow* window = &windows[step % 2];
+    int width = (1 + rand() % 8) * 8;
+    int height = 1 + rand() % (WINDOW_BYTES / (width / 8));
+    int x = rand() % 25 * 8;
+    int y = rand() % EPD_HEIGHT;
+
+    for (int i = 0; i < width / 8 * height; i++) {
+      image[i] = rand();
+    }
+    put(image, x, y, width, height);
+    if (rand() % 8 == 0) {
+      epd.setFrameMemory(image, x, y, width, height);
+      continue;
+    }
+    window->index = step;
+    /* the part inside the display */
+    window->bytes = ((x + width > EPD_WIDTH ? EPD_WIDTH : x + width) - x) / 8 * ((y + height > EPD_HEIGHT ? EPD_HEIGHT : y + height) - y);
+    if (epd.setFrameMemoryAsync(image, x, y, width, height, asyncSent, window) != 0) {
+      errors++;
+    }
+    queued++;
+    if (rand() % 4 == 0) {
+      EPDHost::finishDma();
+      errors += compareRam(reference);
+    }
+  }
+  EPDHost::finishDma();
+  errors += compareRam(reference);
+  errors += asyncCount != queued;
+  return errors + asyncErrors;
+}
+
+/**
+ *  up to BATCH_WINDOWS windows of random bytes, mostly stacked right below
+ *  each other with the same x and width, which the batch sends as one,
+ *  some of them cut by the edge of the display. frame gets them in order.
+ */
+static int randomWindows(EPDWindow* windows, unsigned char images[][WINDOW_BYTES]) {
+  int count = 1 + rand() % BATCH_WINDOWS;
+  int width = (1 + rand() % 8) * 8;
+  int x = rand() % 25 * 8;
+  int y = rand() % EPD_HEIGHT;
+
+  for (int k = 0; k < count; k++) {
+    if (rand() % 4 == 0) {
+      width = (1 + rand() % 8) * 8;
+      x = rand() % 25 * 8;
+    }
+    windows[k].image = images[k];
+    windows[k].x = x;
+    windows[k].y = y;
+    windows[k].width = width;
+    windows[k].height = 1 + rand() % 12;
+    for (int i = 0; i < width / 8 * windows[k].height; i++) {
+      images[k][i] = rand();
+    }
+    put(images[k], x, y, width, windows[k].height);
+    y += windows[k].height;
+  }
+  return count;
+}
+
+/* the batch setFrameMemory() against the bank it writes */
+static int checkBatch(EPD1in54& epd, EPD1in54& reference) {
+  static unsigned char images[BATCH_WINDOWS][WINDOW_BYTES];
+  EPDWindow windows[BATCH_WINDOWS];
+  int errors = 0;
+
+  start(epd);
+  for (int step = 0; step < 200; step++) {
+    int count = randomWindows(windows, images);
+    epd.setFrameMemory(windows, count);
+    errors += compareRam(reference);
+  }
+  return errors;
+}
+
+/**
+ *  windows sent once each, by setFrameMemory(), the batch and
+ *  clearFrameMemory(), and displayed once with a bank scratch of size
+ *  bytes: the bank shown has to hold all of them every time. the windows
+ *  of a refresh have to fit into the scratch, up to 96 bytes of a window
+ *  and its header, of at most WINDOW_HEADER bytes. they fill most of it,
+ *  so that the windows of the refresh before are replayed early.
+ */
+static int checkBanks(EPD1in54& epd, EPD1in54& reference, unsigned int size) {
+  static unsigned char scratch[6000];
+  static unsigned char images[BATCH_WINDOWS][WINDOW_BYTES];
+  EPDWindow windows[BATCH_WINDOWS];
+  int errors = 0;
+
+  epd.setBankScratch(scratch, size);
+  /* both banks hold the first frame */
+  start(epd);
+  epd.displayFrame();
+  epd.setFrameMemory(frame, 0, 0, EPD_WIDTH, EPD_HEIGHT);
+  epd.displayFrame();
+  for (int step = 0; step < 200; step++) {
+    unsigned int used = 0;
+    while (used + BATCH_WINDOWS * (96 + WINDOW_HEADER) <= size && rand() % 8 != 0) {
+      int count = randomWindows(windows, images);
+      for (int k = 0; k < count; k++) {
+        used += windows[k].width / 8 * windows[k].height + WINDOW_HEADER;
+      }
+      if (rand() % 2) {
+        epd.setFrameMemory(windows, count);
+      } else {
+        epd.setFrameMemory(windows[0].image, windows[0].x, windows[0].y, windows[0].width, windows[0].height);
+        /* the other windows never reached the module */
+        epd.setFrameMemory(windows + 1, count - 1);
+      }
+    }
+    if (rand() % 50 == 0) {
+      unsigned char color = rand();
+      epd.clearFrameMemory(color);
+      memset(frame, color, EPDRAMMODEL_BYTES);
+    }
+    epd.displayFrame();
+    ram.feed();
+    reference.setFrameMemory(frame, 0, 0, EPD_WIDTH, EPD_HEIGHT);
+    plain.feed();
+    errors += memcmp(ram.shown(), plain.bank(plain.getWriteBank()), EPDRAMMODEL_BYTES) != 0;
+  }
+  epd.setBankScratch(NULL, 0);
+  return errors;
+}
+
+static sFONT* fonts[] = {&Font8, &Font12, &Font16, &Font20, &Font24};
+
+/* a frame of random drawing calls of every kind, partly off the display */
+static void recordList(EPDDisplayList& list) {
+  static unsigned char bitmap[3 * 20];
+
+  for (unsigned int i = 0; i < sizeof(bitmap); i++) {
+    bitmap[i] = rand();
+  }
+  list.reset();
+  list.clear(rand() & 1);
+  for (int i = 0; i < 40; i++) {
+    int x = rand() % (EPD_WIDTH + 40) - 20;
+    int y = rand() % (EPD_HEIGHT + 40) - 20;
+    int colored = rand() & 1;
+    switch (rand() % 6) {
+      case 0:
+        list.drawStringAt(x, y, "band 12", fonts[rand() % 5], colored);
+        break;
+      case 1:
+        list.drawCircle(x, y, rand() % 40, colored);
+        break;
+      case 2:
+        list.drawFilledCircle(x, y, rand() % 40, colored);
+        break;
+      case 3:
+        list.drawLine(x, y, rand() % EPD_WIDTH, rand() % EPD_HEIGHT, colored);
+        break;
+      case 4:
+        list.drawBitmapAt(x, y, bitmap, 20, 20, colored);
+        break;
+      default:
+        list.drawFilledRectangle(x, y, x + rand() % 60, y + rand() % 60, colored);
+        break;
+    }
+  }
+}
+
+/**
+ *  a display list drawn band by band by setFrameMemory(list, band), for
+ *  every rotation and band height, against the list drawn into frame.
+ *  with spare, every second band is drawn there and sent asynchronously.
+ */
+static int checkDisplayList(EPD1in54& epd, EPD1in54& reference, unsigned char* spare) {
+  static unsigned char calls[2048];
+  static unsigned char rows[EPDRAMMODEL_BYTES];
+  EPDDisplayList list(calls, sizeof(calls));
+  int errors = 0;
+
+  /* a band paint not of the display size sends nothing */
+  EPDPaint narrow(rows, EPD_WIDTH - 8, EPD_HEIGHT);
+  recordList(list);
+  errors += epd.setFrameMemory(list, narrow, spare) != -1;
+  errors += !EPDHost::record().empty();
+  start(epd);
+  for (int rotate = ROTATE_0; rotate <= ROTATE_270; rotate++) {
+    for (unsigned int b = 0; b < sizeof(bandRows) / sizeof(bandRows[0]); b++) {
+      EPDPaint band(rows, EPD_WIDTH, EPD_HEIGHT);
+      EPDPaint whole(frame, EPD_WIDTH, EPD_HEIGHT);
+
+      recordList(list);
+      errors += list.isOverflow();
+      band.setRotate(rotate);
+      band.setBand(0, bandRows[b]);
+      whole.setRotate(rotate);
+      list.render(whole);
+      if (spare != NULL) {
+        memset(spare, 0x5A, EPDRAMMODEL_BYTES);
+      }
+      errors += epd.setFrameMemory(list, band, spare) != 0;
+      /* the second band was drawn into the spare buffer */
+      if (spare != NULL && bandRows[b] < EPD_HEIGHT) {
+        errors += spare[0] == 0x5A && spare[EPDRAMMODEL_LINE_BYTES * bandRows[b] - 1] == 0x5A;
+      }
+      /* the band is the first one again */
+      errors += band.getImage() != rows || band.getBandY() != 0 || band.getBandHeight() != bandRows[b];
+      errors += compareRam(reference);
+    }
+  }
+  return errors;
+}
+
+/* a row source of an image in RAM that checks what it is asked for */
+struct CheckedRows {
+  const unsigned char* image;
+  int rowBytes;
+  int rowCount;
+  int next;
+  int errors;
+};
+
+static void fillChecked(unsigned char* rows, int y, int count, int row_bytes, void* arg) {
+  CheckedRows* source = (CheckedRows*) arg;
+
+  /* the lines come in order, never more than the buffer holds */
+  source->errors += y != source->next || count <= 0 || count > source->rowCount || row_bytes != source->rowBytes;
+  source->next = y + count;
+  memcpy(rows, &source->image[y * row_bytes], count * row_bytes);
+}
+
+/**
+ *  windows sent by setFrameMemory(const EPDRowSource&, ...) from RAM, from
+ *  PROGMEM and from a fill of its own, through row buffers of every size,
+ *  against the windows put into frame
+ */
+static int checkRowSources(EPD1in54& epd, EPD1in54& reference) {
+  static unsigned char image[EPDRAMMODEL_BYTES];
+  static unsigned char rows[EPDRAMMODEL_BYTES];
+  CheckedRows checked;
+  EPDRowSource source;
+  int errors = 0;
+
+  /* nothing to send and no row buffer */
+  errors += epd.setFrameMemory(rowSourceRam(image), 0, EPD_HEIGHT, EPD_WIDTH, 8, rows, 1) != -1;
+  errors += epd.setFrameMemory(rowSourceRam(image), 0, 0, 7, 8, rows, 1) != -1;
+  errors += epd.setFrameMemory(rowSourceRam(image), rows, 0) != -1;
+  errors += !EPDHost::record().empty();
+  start(epd);
+  for (int step = 0; step < 200; step++) {
+    int whole = step % 10 == 0;
+    int x = whole ? 0 : rand() % EPDRAMMODEL_LINE_BYTES * 8;
+    int y = whole ? 0 : rand() % EPD_HEIGHT;
+    int width = whole ? EPD_WIDTH : (rand() % EPDRAMMODEL_LINE_BYTES + 1) * 8;
+    int height = whole ? EPD_HEIGHT : rand() % EPD_HEIGHT + 1;
+    int row_count = rand() % 4 == 0 ? height : rand() % 40 + 1;
+
+    for (int i = 0; i < width / 8 * height; i++) {
+      image[i] = rand();
+    }
+    switch (step % 3) {
+      case 0:
+        source = rowSourceRam(image);
+        break;
+      case 1:
+        source = rowSourceProgmem(image);
+        break;
+      default:
+        checked.image = image;
+        checked.rowBytes = width / 8;
+        checked.rowCount = row_count;
+        checked.next = 0;
+        checked.errors = 0;
+        source.fill = fillChecked;
+        source.arg = &checked;
+        break;
+    }
+    if (whole) {
+      errors += epd.setFrameMemory(source, rows, row_count) != 0;
+    } else {
+      errors += epd.setFrameMemory(source, x, y, width, height, rows, row_count) != 0;
+    }
+    put(image, x, y, width, height);
+    if (step % 3 == 2) {
+      /* every line on the display was asked for */
+      errors += checked.errors != 0;
+      errors += checked.next != (y + height > EPD_HEIGHT ? EPD_HEIGHT - y : height);
+    }
+    errors += compareRam(reference);
+  }
+  return errors;
+}
+
+int main(void) {
+  static unsigned char spare[EPDRAMMODEL_BYTES];
+  EPD1in54 epd;
+  EPD1in54 reference;
+  int errors = 0;
+  int failed;
+
+  srand(1);
+  EPDHost::begin();
+  EPDHost::addBusyCommand(MASTER_ACTIVATION, 300);
+  epd.init(lutFullUpdate);
+  reference.init(lutFullUpdate);
+  EPDHost::clear();
+
+  failed = checkAsync(epd, reference);
+  printf("EPDFrameTest: setFrameMemoryAsync(), %d checks failed\n", failed);
+  errors += failed;
+  failed = checkBatch(epd, reference);
+  printf("EPDFrameTest: setFrameMemory(const EPDWindow*, count), %d checks failed\n", failed);
+  errors += failed;
+  failed = checkDisplayList(epd, reference, NULL);
+  printf("EPDFrameTest: setFrameMemory(const EPDDisplayList&, EPDPaint&), %d checks failed\n", failed);
+  errors += failed;
+  failed = checkDisplayList(epd, reference, spare);
+  printf("EPDFrameTest: setFrameMemory(const EPDDisplayList&, EPDPaint&, spare), %d checks failed\n", failed);
+  errors += failed;
+  failed = checkRowSources(epd, reference);
+  printf("EPDFrameTest: setFrameMemory(const EPDRowSource&, ...), %d checks failed\n", failed);
+  errors += failed;
+  /* the smallest scratch is replayed early all the time to make room */
+  for (unsigned int c = 0; c < sizeof(scratchSizes) / sizeof(scratchSizes[0]); c++) {
+    failed = checkBanks(epd, reference, scratchSizes[c]);
+    printf("EPDFrameTest: setBankScratch() of %u bytes, %d checks failed\n", scratchSizes[c], failed);
+    errors += failed;
+  }
+  return errors == 0 ? 0 : 1;
+}
+
+/* END OF FILE */
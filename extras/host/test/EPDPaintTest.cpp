@@ -0,0 +1,309 @@
+/**
+ *  @filename   :   EPDPaintTest.cpp
+ *  @brief      :   Checks the drawing of EPDPaint against EPDPaintReference, the
+ *                  EPDPaint of the first release, on every rotation and a few bands
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EPDPaint.h>
+#include <EPDFixedPaint.h>
+#include <EPDGlyphCache.h>
+#include "EPDPaintReference.h"
+
+#define IMAGE_BYTES     6000
+#define TRIALS          40
+
+static unsigned char image[IMAGE_BYTES];
+static unsigned char referenceImage[IMAGE_BYTES];
+
+/* the glyph cache compare() gives the paints, if not NULL */
+static EPDGlyphCache* glyphCache = NULL;
+
+/* budgets from less than a glyph of Font24 to every glyph drawn */
+static const unsigned int cacheSizes[] = {40, 80, 300, 8192};
+
+/* the paint sizes, 13 is padded to 16 by both paints */
+static const int sizes[][2] = {{200, 200}, {152, 152}, {96, 80}, {13, 37}};
+
+/* a coordinate of drawPixel(), up to 16 pixels outside the paint */
+static int coordinate(int size) {
+  return rand() % (size + 32) - 16;
+}
+
+/* the same random drawing calls on both paints */
+typedef void (*Drawing)(EPDPaint& paint, EPDPaintReference& reference, int width, int height);
+
+static void drawFills(EPDPaint& paint, EPDPaintReference& reference, int width, int height) {
+  int x0 = coordinate(width);
+  int y0 = coordinate(height);
+  int x1 = coordinate(width);
+  int y1 = coordinate(height);
+  int colored = rand() & 1;
+  unsigned char pattern[8];
+
+  switch (rand() % 4) {
+    case 0:
+      paint.clear(colored);
+      reference.clear(colored);
+      break;
+    case 1:
+      paint.fillRegion(x0, y0, x1, y1, colored);
+      reference.drawFilledRectangle(x0, y0, x1, y1, colored);
+      break;
+    case 2:
+      paint.drawFilledRectangle(x0, y0, x1, y1, colored);
+      reference.drawFilledRectangle(x0, y0, x1, y1, colored);
+      break;
+    default:
+      for (int i = 0; i < 8; i++) {
+        pattern[i] = rand();
+      }
+      paint.fillPattern(pattern);
+      for (int y = 0; y < reference.getHeight(); y++) {
+        for (int x = 0; x < reference.getWidth(); x++) {
+          reference.drawAbsolutePixel(x, y, pattern[y % 8] & (0x80 >> (x % 8)));
+        }
+      }
+      break;
+  }
+}
+
+template <class Paint>
+static void drawShapes(Paint& paint, EPDPaintReference& reference, int width, int height) {
+  int x0 = coordinate(width);
+  int y0 = coordinate(height);
+  int x1 = coordinate(width);
+  int y1 = coordinate(height);
+  /* a negative radius draws 4 pixels in the first release */
+  int radius = rand() % 4 ? rand() % 60 : -1 - rand() % 8;
+  int colored = rand() & 1;
+
+  switch (rand() % 7) {
+    case 0:
+      paint.drawLine(x0, y0, x1, y1, colored);
+      reference.drawLine(x0, y0, x1, y1, colored);
+      break;
+    case 1:
+      paint.drawHorizontalLine(x0, y0, x1, colored);
+      reference.drawHorizontalLine(x0, y0, x1, colored);
+      break;
+    case 2:
+      paint.drawVerticalLine(x0, y0, y1, colored);
+      reference.drawVerticalLine(x0, y0, y1, colored);
+      break;
+    case 3:
+      paint.drawRectangle(x0, y0, x1, y1, colored);
+      reference.drawRectangle(x0, y0, x1, y1, colored);
+      break;
+    case 4:
+      paint.drawCircle(x0, y0, radius, colored);
+      reference.drawCircle(x0, y0, radius, colored);
+      break;
+    case 5:
+      paint.drawFilledCircle(x0, y0, radius, colored);
+      reference.drawFilledCircle(x0, y0, radius, colored);
+      break;
+    default:
+      paint.drawPixel(x0, y0, colored);
+      reference.drawPixel(x0, y0, colored);
+      break;
+  }
+}
+
+static sFONT* fonts[] = {&Font8, &Font12, &Font16, &Font20, &Font24};
+
+/* the calls of EPDFixedPaint, whose rotation is a template parameter */
+template <class Paint>
+static void drawFixed(Paint& paint, EPDPaintReference& reference, int width, int height) {
+  int x0 = coordinate(width);
+  int y0 = coordinate(height);
+  int x1 = coordinate(width);
+  int y1 = coordinate(height);
+  int colored = rand() & 1;
+  char ascii_char = ' ' + rand() % 95;
+  sFONT* font = fonts[rand() % 5];
+
+  switch (rand() % 5) {
+    case 0:
+      paint.clear(colored);
+      reference.clear(colored);
+      break;
+    case 1:
+      paint.fillRegion(x0, y0, x1, y1, colored);
+      reference.drawFilledRectangle(x0, y0, x1, y1, colored);
+      break;
+    case 2:
+      paint.drawFilledRectangle(x0, y0, x1, y1, colored);
+      reference.drawFilledRectangle(x0, y0, x1, y1, colored);
+      break;
+    case 3:
+      paint.drawCharAt(x0, y0, ascii_char, font, colored);
+      reference.drawCharAt(x0, y0, ascii_char, font, colored);
+      break;
+    default:
+      drawShapes(paint, reference, width, height);
+      break;
+  }
+}
+
+static void drawText(EPDPaint& paint, EPDPaintReference& reference, int width, int height) {
+  int x = coordinate(width);
+  int y = coordinate(height);
+  int colored = rand() & 1;
+  sFONT* font = fonts[rand() % 5];
+  char ascii_char = ' ' + rand() % 95;
+  char text[8];
+  int length = rand() % 8;
+
+  for (int i = 0; i < length; i++) {
+    text[i] = ' ' + rand() % 95;
+  }
+  text[length] = '\0';
+  if (rand() % 2) {
+    paint.drawCharAt(x, y, ascii_char, font, colored);
+    reference.drawCharAt(x, y, ascii_char, font, colored);
+  } else {
+    paint.drawStringAt(x, y, text, font, colored);
+    reference.drawStringAt(x, y, text, font, colored);
+  }
+}
+
+/* true if the images and the damage of both paints are the same */
+static bool same(EPDPaint& paint, EPDPaintReference& reference) {
+  return memcmp(image, referenceImage, IMAGE_BYTES) == 0 &&
+    paint.hasDamage() == reference.hasDamage() &&
+    paint.getDamageX() == reference.getDamageX() &&
+    paint.getDamageY() == reference.getDamageY() &&
+    paint.getDamageWidth() == reference.getDamageWidth() &&
+    paint.getDamageHeight() == reference.getDamageHeight();
+}
+
+/**
+ *  runs the drawing on every size, rotation and a few bands, from the
+ *  same random image, and counts the trials that came out different
+ */
+static int compare(const char* name, Drawing drawing) {
+  int errors = 0;
+  int trials = 0;
+
+  srand(1);
+  for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    for (int rotate = ROTATE_0; rotate <= ROTATE_270; rotate++) {
+      for (int band = 0; band < 4; band++) {
+        EPDPaint paint(image, sizes[s][0], sizes[s][1]);
+        EPDPaintReference reference(referenceImage, sizes[s][0], sizes[s][1]);
+        int height = paint.getHeight();
+        /* the whole paint first, then random bands */
+        int band_y = band == 0 ? 0 : rand() % height;
+        int band_height = band == 0 ? height : 1 + rand() % (height - band_y);
+        bool rotated = rotate == ROTATE_90 || rotate == ROTATE_270;
+        int width = rotated ? paint.getHeight() : paint.getWidth();
+        height = rotated ? paint.getWidth() : paint.getHeight();
+
+        paint.setGlyphCache(glyphCache);
+        paint.setRotate(rotate);
+        reference.setRotate(rotate);
+        paint.setBand(band_y, band_height);
+        reference.setBand(band_y, band_height);
+        for (int trial = 0; trial < TRIALS; trial++) {
+          for (int i = 0; i < IMAGE_BYTES; i++) {
+            image[i] = rand();
+          }
+          memcpy(referenceImage, image, IMAGE_BYTES);
+          paint.clearDamage();
+          reference.clearDamage();
+          for (int k = rand() % 3; k >= 0; k--) {
+            drawing(paint, reference, width, height);
+          }
+          if (!same(paint, reference)) {
+            errors++;
+          }
+          trials++;
+        }
+      }
+    }
+  }
+  printf("EPDPaintTest: %s, %d of %d differ\n", name, errors, trials);
+  return errors;
+}
+
+/* as compare(), for an EPDFixedPaint of the rotation, which has no band */
+template <int ROTATE>
+static int compareFixed(void) {
+  int errors = 0;
+  int trials = 0;
+
+  srand(1);
+  for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    EPDFixedPaint<ROTATE> paint(image, sizes[s][0], sizes[s][1]);
+    EPDPaintReference reference(referenceImage, sizes[s][0], sizes[s][1]);
+    bool rotated = ROTATE == ROTATE_90 || ROTATE == ROTATE_270;
+    int width = rotated ? paint.getHeight() : paint.getWidth();
+    int height = rotated ? paint.getWidth() : paint.getHeight();
+
+    reference.setRotate(ROTATE);
+    for (int trial = 0; trial < TRIALS * 4; trial++) {
+      for (int i = 0; i < IMAGE_BYTES; i++) {
+        image[i] = rand();
+      }
+      memcpy(referenceImage, image, IMAGE_BYTES);
+      for (int k = rand() % 3; k >= 0; k--) {
+        drawFixed(paint, reference, width, height);
+      }
+      if (memcmp(image, referenceImage, IMAGE_BYTES) != 0) {
+        errors++;
+      }
+      trials++;
+    }
+  }
+  printf("EPDPaintTest: EPDFixedPaint<%d>, %d of %d differ\n", ROTATE, errors, trials);
+  return errors;
+}
+
+int main(void) {
+  int errors = 0;
+
+  errors += compare("fills", drawFills);
+  errors += compare("shapes", drawShapes<EPDPaint>);
+  errors += compare("text", drawText);
+  for (unsigned int c = 0; c < sizeof(cacheSizes) / sizeof(cacheSizes[0]); c++) {
+    static unsigned char buffer[8192];
+    EPDGlyphCache cache(buffer, cacheSizes[c]);
+    char name[40];
+
+    glyphCache = &cache;
+    snprintf(name, sizeof(name), "text, a glyph cache of %u bytes", cacheSizes[c]);
+    errors += compare(name, drawText);
+    printf("EPDPaintTest: %lu hits, %lu misses\n", cache.getHits(), cache.getMisses());
+    /* a cache that is never hit checks nothing */
+    errors += cache.getHits() == 0 ? 1 : 0;
+    glyphCache = NULL;
+  }
+  errors += compareFixed<ROTATE_0>();
+  errors += compareFixed<ROTATE_90>();
+  errors += compareFixed<ROTATE_180>();
+  errors += compareFixed<ROTATE_270>();
+  return errors == 0 ? 0 : 1;
+}
+
+/* END OF FILE */
@@ -0,0 +1,164 @@
+/**
+ *  @filename   :   EPDRamModel.h
+ *  @brief      :   The RAM of the controller of EPD1in54, for the checks of
+ *                  extras/host/test
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef EPDRAMMODEL_H
+#define EPDRAMMODEL_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <EPDHost.h>
+#include <EPD1in54.h>
+
+#define EPDRAMMODEL_LINE_BYTES  (EPD_WIDTH / 8)
+#define EPDRAMMODEL_BYTES       (EPDRAMMODEL_LINE_BYTES * EPD_HEIGHT)
+
+/**
+ *  the two RAM banks of an SSD1608, written by the bytes EPDHost recorded.
+ *  WRITE_RAM goes to the bank written since the last MASTER_ACTIVATION,
+ *  which shows that bank and makes the other one written from then on,
+ *  the way EPD1in54 tracks it (see EPD1in54::getRamBank()).
+ */
+class EPDRamModel {
+ public:
+  EPDRamModel() {
+    reset(0xFF);
+  }
+
+  /**
+   *  @brief: fill both banks and the shown frame, bank 0 written next
+   */
+  void reset(unsigned char value) {
+    memset(this->banks, value, sizeof(this->banks));
+    memset(this->shownFrame, value, sizeof(this->shownFrame));
+    this->writeBank = 0;
+    this->written[0] = 0;
+    this->written[1] = 0;
+    this->command = 0;
+    this->argCount = 0;
+    this->xStart = 0;
+    this->xEnd = EPDRAMMODEL_LINE_BYTES - 1;
+    this->yStart = 0;
+    this->yEnd = EPD_HEIGHT - 1;
+    this->xCounter = 0;
+    this->yCounter = 0;
+  }
+
+  /**
+   *  @brief: random contents in both banks, as after power on
+   */
+  void scramble(void) {
+    for (int i = 0; i < EPDRAMMODEL_BYTES; i++) {
+      this->banks[0][i] = rand();
+      this->banks[1][i] = rand();
+    }
+  }
+
+  /**
+   *  @brief: the bytes EPDHost recorded since the last feed(), which clears
+   *          the record
+   */
+  void feed(void) {
+    const std::vector<EPDHostByte>& record = EPDHost::record();
+    for (size_t i = 0; i < record.size(); i++) {
+      feedByte(record[i].value, record[i].dc);
+    }
+    EPDHost::clear();
+  }
+
+  unsigned char* bank(int index) {
+    return this->banks[index];
+  }
+
+  /**
+   *  @brief: the frame the last MASTER_ACTIVATION showed
+   */
+  const unsigned char* shown(void) {
+    return this->shownFrame;
+  }
+
+  int getWriteBank(void) {
+    return this->writeBank;
+  }
+
+  /**
+   *  @brief: the WRITE_RAM bytes a bank got since the last call
+   */
+  unsigned long takeWritten(int index) {
+    unsigned long written = this->written[index];
+    this->written[index] = 0;
+    return written;
+  }
+
+ private:
+  unsigned char banks[2][EPDRAMMODEL_BYTES];
+  unsigned char shownFrame[EPDRAMMODEL_BYTES];
+  unsigned char args[4];
+  unsigned long written[2];
+  int writeBank;
+  int command;
+  unsigned int argCount;
+  int xStart, xEnd, yStart, yEnd, xCounter, yCounter;
+
+  void feedByte(unsigned char value, unsigned char dc) {
+    if (!dc) {
+      this->command = value;
+      this->argCount = 0;
+      if (value == MASTER_ACTIVATION) {
+        memcpy(this->shownFrame, this->banks[this->writeBank], EPDRAMMODEL_BYTES);
+        this->writeBank ^= 1;
+      }
+      return;
+    }
+    if (this->argCount < sizeof(this->args)) {
+      this->args[this->argCount] = value;
+    }
+    this->argCount++;
+    if (this->command == SET_RAM_X_ADDRESS_START_END_POSITION && this->argCount == 2) {
+      this->xStart = this->args[0];
+      this->xEnd = this->args[1];
+    } else if (this->command == SET_RAM_Y_ADDRESS_START_END_POSITION && this->argCount == 4) {
+      this->yStart = this->args[0] | this->args[1] << 8;
+      this->yEnd = this->args[2] | this->args[3] << 8;
+    } else if (this->command == SET_RAM_X_ADDRESS_COUNTER && this->argCount == 1) {
+      this->xCounter = this->args[0];
+    } else if (this->command == SET_RAM_Y_ADDRESS_COUNTER && this->argCount == 2) {
+      this->yCounter = this->args[0] | this->args[1] << 8;
+    } else if (this->command == WRITE_RAM) {
+      if (this->xCounter < EPDRAMMODEL_LINE_BYTES && this->yCounter < EPD_HEIGHT) {
+        this->banks[this->writeBank][this->yCounter * EPDRAMMODEL_LINE_BYTES + this->xCounter] = value;
+      }
+      this->written[this->writeBank]++;
+      if (++this->xCounter > this->xEnd) {
+        this->xCounter = this->xStart;
+        if (++this->yCounter > this->yEnd) {
+          this->yCounter = this->yStart;
+        }
+      }
+    }
+  }
+};
+
+#endif
+
+/* END OF FILE */
@@ -0,0 +1,174 @@
+/**
+ *  @filename   :   EPDServiceTest.cpp
+ *  @brief      :   Checks EPDDisplayService against drawing and sending on the
+ *                  caller alone
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <EPDHost.h>
+#include <EPDDisplayService.h>
+#include <EPDGlyphCache.h>
+#include "EPDRamModel.h"
+
+static unsigned char calls[4096];
+static unsigned char frame[EPDRAMMODEL_BYTES];
+static unsigned char next[EPDRAMMODEL_BYTES];
+static unsigned char expected[EPDRAMMODEL_BYTES];
+static unsigned char callerCache[600];
+static unsigned char taskCache[600];
+
+/* the refresh of the service task is held until the caller is done */
+static std::atomic<bool> hold(false);
+
+static void holdRefresh(unsigned long, unsigned long, void*) {
+  while (hold) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+/* the bands rendered: the whole frame, an odd number of rows, one row */
+static const int bands[][2] = {{0, EPD_HEIGHT}, {37, 51}, {199, 1}};
+
+static sFONT* fonts[] = {&Font8, &Font12, &Font16, &Font20, &Font24};
+
+static void record(EPDDisplayList& list) {
+  srand(1);
+  list.clear(0);
+  for (int i = 0; i < 60; i++) {
+    int x = rand() % EPD_WIDTH;
+    int y = rand() % EPD_HEIGHT;
+    switch (rand() % 4) {
+      case 0:
+        list.drawStringAt(x - 20, y - 10, "service", fonts[rand() % 5], 1);
+        break;
+      case 1:
+        list.drawFilledCircle(x, y, rand() % 30, rand() & 1);
+        break;
+      case 2:
+        list.drawLine(x, y, rand() % EPD_WIDTH, rand() % EPD_HEIGHT, 1);
+        break;
+      default:
+        list.drawFilledRectangle(x, y, x + rand() % 40, y + rand() % 40, rand() & 1);
+        break;
+    }
+  }
+}
+
+/* the list drawn by the caller alone, the way render() splits nothing */
+static void renderAlone(const EPDDisplayList& list, int rotate, int y, int rows) {
+  EPDPaint paint(expected, EPD_WIDTH, EPD_HEIGHT);
+  paint.setRotate(rotate);
+  paint.setBand(y, rows);
+  list.render(paint);
+}
+
+/* render() into image, compared with renderAlone() */
+static int renderService(EPDDisplayService& service, const EPDDisplayList& list, EPDGlyphCache& cache, unsigned char* image, int rotate, int y, int rows) {
+  EPDPaint paint(image, EPD_WIDTH, EPD_HEIGHT);
+  paint.setRotate(rotate);
+  paint.setBand(y, rows);
+  paint.setGlyphCache(&cache);
+  memset(image, 0x5A, EPDRAMMODEL_BYTES);
+  renderAlone(list, rotate, y, rows);
+  service.render(list, paint);
+  return memcmp(image, expected, EPDRAMMODEL_LINE_BYTES * rows) != 0;
+}
+
+/**
+ *  every band and rotation is rendered while the service is idle, which
+ *  splits the rows with the task, and while it shows a frame, which does
+ *  not. the frames shown are compared with the RAM of the module.
+ *  without the task everything is done by the caller.
+ */
+static int checkService(EPD1in54& epd, const EPDDisplayList& list, bool task) {
+  EPDDisplayService service(epd);
+  EPDGlyphCache caller_cache(callerCache, sizeof(callerCache));
+  EPDGlyphCache task_cache(taskCache, sizeof(taskCache));
+  EPDRamModel ram;
+  EPDServiceStats stats;
+  unsigned long renders = 0;
+  unsigned long splits = 0;
+  unsigned long frames = 0;
+  int errors = 0;
+
+  if (task && service.begin() != 0) {
+    return 1;
+  }
+  service.setGlyphCache(&task_cache);
+  EPDHost::clear();
+  for (int rotate = ROTATE_0; rotate <= ROTATE_270; rotate++) {
+    for (unsigned int b = 0; b < sizeof(bands) / sizeof(bands[0]); b++) {
+      /* idle: the task draws the lower half */
+      errors += renderService(service, list, caller_cache, frame, rotate, bands[b][0], bands[b][1]);
+      renders++;
+      splits += task && bands[b][1] > 1 ? 1 : 0;
+      service.getStats(&stats);
+      errors += stats.renders != renders || stats.splitRenders != splits;
+      errors += stats.scaling == 0;
+      if (bands[b][1] != EPD_HEIGHT) {
+        continue;
+      }
+      printf("EPDServiceTest: rotation %d, render %lu us, work %lu us, scaling %u%%\n", rotate, stats.renderUs, stats.workUs, stats.scaling);
+      /* busy: the caller draws the next frame alone */
+      hold = task;
+      errors += !service.submit(frame);
+      frames++;
+      errors += renderService(service, list, caller_cache, next, (rotate + 1) % 4, 0, EPD_HEIGHT);
+      renders++;
+      /* the task refuses a frame while it shows one */
+      errors += task && service.submit(next);
+      hold = false;
+      service.waitIdle();
+      errors += !service.isIdle();
+      ram.feed();
+      errors += memcmp(ram.shown(), frame, EPDRAMMODEL_BYTES) != 0;
+      service.getStats(&stats);
+      errors += stats.frames != frames || stats.frameMs < EPD1IN54_REFRESH_MS / 10;
+      errors += stats.renders != renders;
+    }
+  }
+  errors += task && (caller_cache.getHits() == 0 || task_cache.getHits() == 0);
+  service.end();
+  return errors;
+}
+
+int main(void) {
+  EPD1in54 epd;
+  EPDDisplayList list(calls, sizeof(calls));
+  int errors = 0;
+
+  record(list);
+  EPDHost::begin();
+  EPDHost::addBusyCommand(MASTER_ACTIVATION, 300);
+  epd.init(lutFullUpdate);
+  epd.setYieldCallback(holdRefresh, NULL);
+  errors += checkService(epd, list, true);
+  errors += checkService(epd, list, false);
+  printf("EPDServiceTest: %d checks failed\n", errors);
+  return errors == 0 ? 0 : 1;
+}
+
+/* END OF FILE */
@@ -0,0 +1,161 @@
+/**
+ *  @filename   :   EPDStreamTest.cpp
+ *  @brief      :   Checks the bytes the drivers send for a fixed set of calls
+ *                  against the recorded ones
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <EPDHost.h>
+#include <EPD1in54.h>
+#include <EPD1in54B.h>
+/* the drivers of both modules define the display size */
+#undef EPD_WIDTH
+#undef EPD_HEIGHT
+#include <EPD1in54C.h>
+#include <EPDPaint.h>
+
+/**
+ *  the bytes are checked by their count and a hash of every byte with its
+ *  DC level. the numbers below are regression goldens: they were recorded
+ *  by this test from the tree of commit cbb2812, they are not derived from
+ *  the first release (the shadow cache of EPDIF already sends fewer bytes
+ *  than it did). a change that means to send other bytes updates them,
+ *  with the new stream checked on a module.
+ */
+struct StreamCheck {
+  const char* name;
+  unsigned long bytes;
+  uint64_t hash;
+};
+
+static const StreamCheck expected[] = {
+  {"EPD1in54 init", 47, 14314371027175621903ULL},
+  {"EPD1in54 frames", 12748, 17089618031866522419ULL},
+  {"EPD1in54B frames", 30167, 12284667523671283135ULL},
+  {"EPD1in54C frames", 8828, 4074853350781691745ULL}
+};
+
+static unsigned char image[1024];
+static unsigned char frame[10000];
+static int errors = 0;
+
+static void check(int index) {
+  const std::vector<EPDHostByte>& record = EPDHost::record();
+  uint64_t hash = 5381;
+  for (size_t i = 0; i < record.size(); i++) {
+    hash = hash * 33 + record[i].value * 2 + record[i].dc;
+  }
+  if (record.size() != expected[index].bytes || hash != expected[index].hash) {
+    errors++;
+  }
+  printf("%s: %lu bytes, hash %llu%s\n", expected[index].name, (unsigned long) record.size(), (unsigned long long) hash,
+         record.size() != expected[index].bytes || hash != expected[index].hash ? " differs" : "");
+  EPDHost::clear();
+}
+
+static void checkEpd1in54(void) {
+  EPD1in54 epd;
+  EPDPaint paint(image, 0, 0);
+
+  EPDHost::begin();
+  EPDHost::addBusyCommand(MASTER_ACTIVATION, 300);
+  epd.init(lutFullUpdate);
+  check(0);
+  epd.clearFrameMemory(0xFF);
+  epd.displayFrame();
+  paint.setWidth(200);
+  paint.setHeight(24);
+  paint.clear(0);
+  paint.drawStringAt(30, 4, "Hello world!", &Font16, 1);
+  epd.setFrameMemory(paint.getImage(), 0, 10, paint.getWidth(), paint.getHeight());
+  paint.setWidth(64);
+  paint.setHeight(64);
+  paint.clear(1);
+  paint.drawRectangle(0, 0, 40, 50, 0);
+  paint.drawLine(0, 0, 40, 50, 0);
+  paint.drawLine(40, 0, 0, 50, 0);
+  epd.setFrameMemory(paint.getImage(), 16, 60, paint.getWidth(), paint.getHeight());
+  paint.clear(1);
+  paint.drawCircle(32, 32, 30, 0);
+  /* cut by the right edge */
+  epd.setFrameMemory(paint.getImage(), 168, 60, paint.getWidth(), paint.getHeight());
+  paint.clear(1);
+  paint.drawFilledRectangle(0, 0, 40, 50, 0);
+  epd.setFrameMemory(paint.getImage(), 16, 130, paint.getWidth(), paint.getHeight());
+  paint.clear(1);
+  paint.drawFilledCircle(32, 32, 30, 0);
+  /* cut by the bottom edge */
+  epd.setFrameMemory(paint.getImage(), 120, 160, paint.getWidth(), paint.getHeight());
+  epd.displayFrame();
+  epd.init(lutPartialUpdate);
+  epd.setFrameMemory(frame);
+  epd.displayFrame();
+  paint.setWidth(32);
+  paint.setHeight(96);
+  paint.setRotate(ROTATE_270);
+  paint.clear(1);
+  paint.drawStringAt(0, 4, "12:34", &Font24, 0);
+  epd.setFrameMemory(paint.getImage(), 80, 72, paint.getWidth(), paint.getHeight());
+  epd.displayFrame();
+  epd.sleep();
+  check(1);
+}
+
+static void checkEpd1in54B(void) {
+  EPD1in54B epd;
+
+  EPDHost::begin(RESET_PIN, DC_PIN, CS_PIN, BUSY_PIN, LOW);
+  EPDHost::addBusyCommand(0x12, 2000);
+  EPDHost::addBusyCommand(0x04, 50);
+  epd.init();
+  epd.displayFrame(frame, frame + 5000);
+  epd.displayFrame(NULL, frame);
+  epd.displayFrame(frame, NULL);
+  epd.sleep();
+  check(2);
+}
+
+static void checkEpd1in54C(void) {
+  EPD1in54C epd;
+
+  EPDHost::begin(RESET_PIN, DC_PIN, CS_PIN, BUSY_PIN, LOW);
+  EPDHost::addBusyCommand(0x12, 2000);
+  EPDHost::addBusyCommand(0x04, 50);
+  epd.init();
+  epd.displayFrame(frame, frame + 5000);
+  epd.displayFrame(NULL, frame);
+  epd.sleep();
+  check(3);
+}
+
+int main(void) {
+  for (int i = 0; i < (int) sizeof(frame); i++) {
+    frame[i] = i * 7;
+  }
+  checkEpd1in54();
+  checkEpd1in54B();
+  checkEpd1in54C();
+  printf("EPDStreamTest: %d streams differ\n", errors);
+  return errors == 0 ? 0 : 1;
+}
+
+/* END OF FILE */
@@ -25,15 +25,89 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include "EPD1in54.h"
 
+// Kinds of the windows kept in the bank scratch
+#define BANK_DATA       0   // the data follows the window in the scratch
+#define BANK_DATA_P     1   // the data is in the flash
+#define BANK_FILL       2   // one color
+#define BANK_STREAM     3   // streamed, the data is gone
+
+/* a window written since the last refresh, kept in the bank scratch */
+struct EPDBankWindow {
+  int x;
+  int y;
+  int x_end;
+  int y_end;
+  unsigned char kind;
+  unsigned char color;
+  bool resent;
+  const unsigned char* data;
+};
+
+/* a window of commitFrame(), in byte columns and lines of tiles */
+struct EPDDiffWindow {
+  unsigned char x_start;
+  unsigned char x_end;
+  unsigned char y_start;
+  unsigned char y_end;
+};
+
+/* bytes sent for a window of commitFrame(), with the commands around them */
+static long diffCost(const EPDDiffWindow& window) {
+  return (long) (window.x_end - window.x_start + 1) * (window.y_end - window.y_start + 1) * EPD_DIFF_TILE_ROWS
+         + EPD_DIFF_WINDOW_COST;
+}
+
+/* the smallest window around two windows */
+static EPDDiffWindow diffJoin(const EPDDiffWindow& a, const EPDDiffWindow& b) {
+  EPDDiffWindow window;
+  window.x_start = a.x_start < b.x_start ? a.x_start : b.x_start;
+  window.x_end = a.x_end > b.x_end ? a.x_end : b.x_end;
+  window.y_start = a.y_start < b.y_start ? a.y_start : b.y_start;
+  window.y_end = a.y_end > b.y_end ? a.y_end : b.y_end;
+  return window;
+}
+
+/* size of a window and its data in the bank scratch */
+static unsigned int bankRecordLength(const EPDBankWindow& window) {
+  if (window.kind != BANK_DATA) {
+    return sizeof(EPDBankWindow);
+  }
+  return sizeof(EPDBankWindow) + (window.x_end - window.x + 1) / 8 * (window.y_end - window.y + 1);
+}
+
+const unsigned char initSequence[] PROGMEM =
+  {
+    DRIVER_OUTPUT_CONTROL, 3,
+      (EPD_HEIGHT - 1) & 0xFF, ((EPD_HEIGHT - 1) >> 8) & 0xFF,
+      0x00,                           // GD = 0; SM = 0; TB = 0;
+    BOOSTER_SOFT_START_CONTROL, 3, 0xD7, 0xD6, 0x9D,
+    WRITE_VCOM_REGISTER, 1, 0xA8,     // VCOM 7C
+    SET_DUMMY_LINE_PERIOD, 1, 0x1A,   // 4 dummy lines per gate
+    SET_GATE_TIME, 1, 0x08,           // 2us per line
+    DATA_ENTRY_MODE_SETTING, 1, 0x03  // X increment; Y increment
+  };
+
 EPD1in54::~EPD1in54() {
 };
 
-EPD1in54::EPD1in54(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy)
-  : EPDIF(reset, dc, cs, busy) {
+EPD1in54::EPD1in54(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy, unsigned long spi_clock)
+  : EPDIF(reset, dc, cs, busy, spi_clock) {
   width = EPD_WIDTH;
   height = EPD_HEIGHT;
+  refreshTime = EPD1IN54_REFRESH_MS;
+  busyPending = false;
+  ramBank = 0;
+  bankScratch = NULL;
+  bankSize = 0;
+  bankPrevious = 0;
+  bankCurrent = 0;
+  frameShadow = NULL;
+  diffPrevious = NULL;
+  diffCurrent = NULL;
+  diffFull = true;
 };
 
 int EPD1in54::init(const unsigned char* lut) {
@@ -43,33 +117,74 @@ int EPD1in54::init(const unsigned char* lut) {
   }
   /* EPD hardware init start */
   this->lut = lut;
+  /* always reset, which also brings back a module that hung or lost
+     power. the register cache is cleared by it, see setUpdateMode()
+     for switching waveforms without a reset */
   reset();
-  sendCommand(DRIVER_OUTPUT_CONTROL);
-  sendData((EPD_HEIGHT - 1) & 0xFF);
-  sendData(((EPD_HEIGHT - 1) >> 8) & 0xFF);
-  sendData(0x00);                     // GD = 0; SM = 0; TB = 0;
-  sendCommand(BOOSTER_SOFT_START_CONTROL);
-  sendData(0xD7);
-  sendData(0xD6);
-  sendData(0x9D);
-  sendCommand(WRITE_VCOM_REGISTER);
-  sendData(0xA8);                     // VCOM 7C
-  sendCommand(SET_DUMMY_LINE_PERIOD);
-  sendData(0x1A);                     // 4 dummy lines per gate
-  sendCommand(SET_GATE_TIME);
-  sendData(0x08);                     // 2us per line
-  sendCommand(DATA_ENTRY_MODE_SETTING);
-  sendData(0x03);                     // X increment; Y increment
+  sendSequence(initSequence, sizeof(initSequence));
   setLut(this->lut);
   /* EPD hardware init end */
+  if (transferFailed()) {
+    return -1;
+  }
   return 0;
 }
 
+/**
+ *  @brief: switch between the full and the partial update waveform
+ *          (lutFullUpdate / lutPartialUpdate) of an initialized module.
+ *          unlike init() this only rewrites the look-up table, and only
+ *          when it changes.
+ */
+void EPD1in54::setUpdateMode(int mode) {
+  /* the look-up table can not be written during a refresh */
+  waitUntilIdle();
+  setLut(mode == EPD_UPDATE_PARTIAL ? lutPartialUpdate : lutFullUpdate);
+}
+
+/**
+ *  @brief: find the fastest SPI clock the module and the wiring can
+ *          carry, up to max_clock, and keep it. see EPDIF::probeClock().
+ *          call this before init(), the module is reset afterwards
+ *          because a garbled command may have changed any register.
+ */
+unsigned long EPD1in54::probeSpiClock(unsigned long max_clock) {
+  unsigned long clock;
+  if (ifInit() != 0) {
+    return getSpiClock();
+  }
+  reset();
+  clock = probeClock(max_clock, checkSpiClock, this);
+  reset();
+  return clock;
+}
+
+/**
+ *  @brief: private clock check for probeSpiClock().
+ *          enabling the clock and the analog circuit keeps the busyPin
+ *          HIGH for a while, which only happens when the commands
+ *          arrived intact.
+ */
+bool EPD1in54::checkSpiClock(void* arg) {
+  EPD1in54* epd = (EPD1in54*) arg;
+  bool passed;
+  epd->sendCommand(DISPLAY_UPDATE_CONTROL_2);
+  epd->sendData(0xC0);
+  epd->sendCommand(MASTER_ACTIVATION);
+  passed = epd->waitBusyLevel(HIGH, 10) && epd->waitBusyLevel(LOW, EPDIF_PROBE_TIMEOUT_MS);
+  /* disable the analog circuit and the clock again */
+  epd->sendCommand(DISPLAY_UPDATE_CONTROL_2);
+  epd->sendData(0x03);
+  epd->sendCommand(MASTER_ACTIVATION);
+  epd->waitBusyLevel(LOW, EPDIF_PROBE_TIMEOUT_MS);
+  return passed;
+}
+
 /**
  *  @brief: basic function for sending commands
  */
 void EPD1in54::sendCommand(unsigned char command) {
-  digitalWrite(dcPin, LOW);
+  dcWrite(LOW);
   spiTransfer(command);
 }
 
@@ -77,17 +192,31 @@ void EPD1in54::sendCommand(unsigned char command) {
  *  @brief: basic function for sending data
  */
 void EPD1in54::sendData(unsigned char data) {
-  digitalWrite(dcPin, HIGH);
+  dcWrite(HIGH);
   spiTransfer(data);
 }
 
+/**
+ *  @brief: send a block of data with DC set once and CS held low
+ */
+void EPD1in54::sendDataBlock(const unsigned char* data, unsigned int len) {
+  dcWrite(HIGH);
+  spiTransferBuffer(data, len);
+}
+
+/**
+ *  @brief: replay a command table from the flash, see EPDIF::sendSequence()
+ */
+void EPD1in54::sendSequence(const unsigned char* table, unsigned int len) {
+  EPDIF::sendSequence(table, len, LOW);
+}
+
 /**
  *  @brief: Wait until the busyPin goes LOW
  */
 void EPD1in54::waitUntilIdle(void) {
-  while(digitalRead(busyPin) == HIGH) {      //LOW: idle, HIGH: busy
-    delayMs(100);
-  }
+  waitBusyLevel(LOW, EPD_WAIT_FOREVER);      //LOW: idle, HIGH: busy
+  busyPending = false;
 }
 
 /**
@@ -96,10 +225,16 @@ void EPD1in54::waitUntilIdle(void) {
  *          see EPD1in54::sleep();
  */
 void EPD1in54::reset(void) {
-  digitalWrite(resetPin, LOW);                //module reset
+  invalidateShadow();
+  resetWrite(LOW);                //module reset
   delayMs(200);
-  digitalWrite(resetPin, HIGH);
+  resetWrite(HIGH);
   delayMs(200);
+  busyPending = true;
+  ramBank = 0;
+  bankPrevious = 0;
+  bankCurrent = 0;
+  diffFull = true;
 }
 
 /**
@@ -107,11 +242,8 @@ void EPD1in54::reset(void) {
  */
 void EPD1in54::setLut(const unsigned char* lut) {
   this->lut = lut;
-  sendCommand(WRITE_LUT_REGISTER);
   /* the length of look-up table is 30 bytes */
-  for (int i = 0; i < 30; i++) {
-    sendData(this->lut[i]);
-  }
+  writeRegister(WRITE_LUT_REGISTER, this->lut, 30);
 }
 
 /**
@@ -125,6 +257,8 @@ void EPD1in54::setFrameMemory(
                               int image_width,
                               int image_height
                               ) {
+  int width = (int) this->width;
+  int height = (int) this->height;
   int x_end;
   int y_end;
 
@@ -138,25 +272,276 @@ void EPD1in54::setFrameMemory(
   /* x point must be the multiple of 8 or the last 3 bits will be ignored */
   x &= 0xF8;
   image_width &= 0xF8;
-  if (x + image_width >= this->width) {
-    x_end = this->width - 1;
+  if (x + image_width >= width) {
+    x_end = width - 1;
+  } else {
+    x_end = x + image_width - 1;
+  }
+  if (y + image_height >= height) {
+    y_end = height - 1;
+  } else {
+    y_end = y + image_height - 1;
+  }
+  /* nothing of the image is on the display */
+  if (x_end < x || y_end < y) {
+    return;
+  }
+  recordWindow(x, y, x_end, y_end, BANK_DATA, 0, image_buffer, image_width / 8);
+  sendFrameWindow(image_buffer, image_width / 8, x, y, x_end, y_end);
+}
+
+/**
+ *  @brief: put several image buffers in RAM to the frame memory.
+ *          windows stacked right below each other with the same x and
+ *          width are sent as one window with one WRITE_RAM command.
+ *          a window cut by the edge of the display is sent on its own.
+ *          this won't update the display.
+ */
+void EPD1in54::setFrameMemory(const EPDWindow* windows, unsigned int count) {
+  int width = (int) this->width;
+  int height = (int) this->height;
+  unsigned int first = 0;
+  unsigned int last;
+  int x;
+  int image_width;
+  int y_end;
+
+  while (first < count) {
+    const EPDWindow& window = windows[first];
+    if (
+        window.image == NULL ||
+        window.x < 0 || window.width <= 0 ||
+        window.y < 0 || window.height <= 0 ||
+        (window.x & 0xF8) + (window.width & 0xF8) > width ||
+        window.y + window.height > height
+        ) {
+      setFrameMemory(window.image, window.x, window.y, window.width, window.height);
+      first++;
+      continue;
+    }
+    /* x point must be the multiple of 8 or the last 3 bits will be ignored */
+    x = window.x & 0xF8;
+    image_width = window.width & 0xF8;
+    y_end = window.y + window.height - 1;
+    for (last = first + 1; last < count; last++) {
+      const EPDWindow& next = windows[last];
+      if (
+          next.image == NULL ||
+          (next.x & 0xF8) != x || (next.width & 0xF8) != image_width ||
+          next.x < 0 || next.y != y_end + 1 || next.height <= 0 ||
+          next.y + next.height > height
+          ) {
+        break;
+      }
+      y_end += next.height;
+    }
+    /* recording may replay the bank scratch, which moves the RAM window */
+    for (unsigned int i = first; i < last; i++) {
+      recordWindow(
+                   x,
+                   windows[i].y,
+                   x + image_width - 1,
+                   windows[i].y + windows[i].height - 1,
+                   BANK_DATA,
+                   0,
+                   windows[i].image,
+                   image_width / 8
+                   );
+    }
+    setMemoryArea(x, window.y, x + image_width - 1, y_end);
+    setMemoryPointer(x, window.y);
+    sendCommand(WRITE_RAM);
+    for (; first < last; first++) {
+      sendDataBlock(windows[first].image, image_width / 8 * windows[first].height);
+    }
+  }
+}
+
+/**
+ *  @brief: put the part of the image of paint drawn since the last call
+ *          (see EPDPaint::hasDamage()) to the frame memory, where x and y
+ *          are the position of the whole image as for setFrameMemory(),
+ *          and clear the damage of paint. false if nothing was drawn.
+ *          of a paint with a band (see EPDPaint::setBand()) only the rows
+ *          of the band are sent.
+ *          this won't update the display.
+ */
+bool EPD1in54::setFrameMemoryDamage(EPDPaint& paint, int x, int y) {
+  int width = (int) this->width;
+  int height = (int) this->height;
+  int line_stride = paint.getWidth() / 8;
+  int x_start = paint.getDamageX() & 0xF8;
+  int y_start = paint.getDamageY();
+  /* x point must be the multiple of 8 or the last 3 bits will be ignored */
+  int x_end = ((paint.getDamageX() + paint.getDamageWidth() + 7) & ~7) - 1;
+  int y_end = y_start + paint.getDamageHeight() - 1;
+  const unsigned char* buffer;
+
+  if (!paint.hasDamage() || x < 0 || y < 0) {
+    return false;
+  }
+  paint.clearDamage();
+  /* the image only holds the rows of the band */
+  if (y_start < paint.getBandY()) {
+    y_start = paint.getBandY();
+  }
+  if (y_end > paint.getBandY() + paint.getBandHeight() - 1) {
+    y_end = paint.getBandY() + paint.getBandHeight() - 1;
+  }
+  x &= 0xF8;
+  if (x + x_end >= width) {
+    x_end = width - 1 - x;
+  }
+  if (y + y_end >= height) {
+    y_end = height - 1 - y;
+  }
+  if (x_start > x_end || y_start > y_end) {
+    return false;
+  }
+  buffer = &paint.getImage()[(y_start - paint.getBandY()) * line_stride + x_start / 8];
+  recordWindow(x + x_start, y + y_start, x + x_end, y + y_end, BANK_DATA, 0, buffer, line_stride);
+  sendFrameWindow(buffer, line_stride, x + x_start, y + y_start, x + x_end, y + y_end);
+  return true;
+}
+
+/**
+ *  @brief: draw list into the frame memory band by band. band is a paint
+ *          of the size of the display whose image holds the rows of one
+ *          band (see EPDPaint::setBand()), its band height is the number
+ *          of rows drawn and sent at a time: a taller band takes more RAM
+ *          but replays list fewer times.
+ *          with spare_image, a second buffer of the size of the image of
+ *          band, a band is drawn into one buffer while the other one is
+ *          sent by EPDIF::spiTransferBufferAsync(), and drawing waits for
+ *          the transfer before it starts on a buffer still being sent.
+ *          -1 if band does not fit the display. this won't update the
+ *          display.
+ */
+int EPD1in54::setFrameMemory(const EPDDisplayList& list, EPDPaint& band, unsigned char* spare_image) {
+  unsigned char* images[2] = {band.getImage(), spare_image};
+  int current = 0;
+  int rows = band.getBandHeight();
+  int count;
+
+  if (band.getWidth() != (int) this->width || band.getHeight() != (int) this->height || rows <= 0) {
+    return -1;
+  }
+  beginFrameMemory();
+  for (int y = 0; y < (int) this->height; y += rows) {
+    count = (int) this->height - y < rows ? (int) this->height - y : rows;
+    band.setImage(images[current]);
+    band.setBand(y, count);
+    list.render(band);
+    if (spare_image == NULL) {
+      writeFrameMemory(images[current], this->width / 8 * count);
+    } else {
+      /* this waits for the band before, which used the other buffer */
+      dcWrite(HIGH);
+      spiTransferBufferAsync(images[current], this->width / 8 * count, NULL, NULL);
+      current ^= 1;
+    }
+  }
+  waitTransfer();
+  band.setImage(images[0]);
+  band.setBand(0, rows);
+  return 0;
+}
+
+/**
+ *  @brief: put an image made by source (see EPDRowSource) to the frame
+ *          memory. rows is a buffer of row_count lines of image_width / 8
+ *          bytes that source fills again and again, so the image never
+ *          has to be in RAM at once. x, y and the size as for
+ *          setFrameMemory(). the image is not kept by setBankScratch().
+ *          -1 if nothing can be sent. this won't update the display.
+ */
+int EPD1in54::setFrameMemory(
+                             const EPDRowSource& source,
+                             int x,
+                             int y,
+                             int image_width,
+                             int image_height,
+                             unsigned char* rows,
+                             int row_count
+                             ) {
+  int width = (int) this->width;
+  int height = (int) this->height;
+  int x_end;
+  int y_end;
+  int row_bytes;
+  int line_bytes;
+  int count;
+
+  if (
+      source.fill == NULL || rows == NULL || row_count <= 0 ||
+      x < 0 || image_width < 0 ||
+      y < 0 || image_height < 0
+      ) {
+    return -1;
+  }
+  /* x point must be the multiple of 8 or the last 3 bits will be ignored */
+  x &= 0xF8;
+  image_width &= 0xF8;
+  if (x + image_width >= width) {
+    x_end = width - 1;
   } else {
     x_end = x + image_width - 1;
   }
-  if (y + image_height >= this->height) {
-    y_end = this->height - 1;
+  if (y + image_height >= height) {
+    y_end = height - 1;
   } else {
     y_end = y + image_height - 1;
   }
+  if (x_end < x || y_end < y) {
+    return -1;
+  }
+  row_bytes = image_width / 8;
+  line_bytes = (x_end - x + 1) / 8;
+  recordWindow(x, y, x_end, y_end, BANK_STREAM, 0, NULL, 0);
   setMemoryArea(x, y, x_end, y_end);
   setMemoryPointer(x, y);
   sendCommand(WRITE_RAM);
-  /* send the image data */
-  for (int j = 0; j < y_end - y + 1; j++) {
-    for (int i = 0; i < (x_end - x + 1) / 8; i++) {
-      sendData(image_buffer[i + j * (image_width / 8)]);
+  for (int j = 0; j <= y_end - y; j += count) {
+    count = y_end - y + 1 - j < row_count ? y_end - y + 1 - j : row_count;
+    source.fill(rows, j, count, row_bytes, source.arg);
+    if (line_bytes == row_bytes) {
+      sendDataBlock(rows, row_bytes * count);
+    } else {
+      for (int k = 0; k < count; k++) {
+        sendDataBlock(&rows[k * row_bytes], line_bytes);
+      }
     }
   }
+  return 0;
+}
+
+/**
+ *  @brief: put a whole frame made by source to the frame memory
+ */
+int EPD1in54::setFrameMemory(const EPDRowSource& source, unsigned char* rows, int row_count) {
+  return setFrameMemory(source, 0, 0, this->width, this->height, rows, row_count);
+}
+
+/**
+ *  @brief: start writing a whole frame to the frame memory, line by line
+ *          from the top, with writeFrameMemory(). nothing else may be
+ *          sent to the module until the frame is complete.
+ *          a frame sent this way is not kept by setBankScratch(), send
+ *          it again after the refresh to have it in both RAM banks.
+ */
+void EPD1in54::beginFrameMemory(void) {
+  recordWindow(0, 0, this->width - 1, this->height - 1, BANK_STREAM, 0, NULL, 0);
+  setMemoryArea(0, 0, this->width - 1, this->height - 1);
+  setMemoryPointer(0, 0);
+  sendCommand(WRITE_RAM);
+}
+
+/**
+ *  @brief: send the next len bytes of the frame started by
+ *          beginFrameMemory()
+ */
+void EPD1in54::writeFrameMemory(const unsigned char* data, unsigned int len) {
+  sendDataBlock(data, len);
 }
 
 /**
@@ -177,13 +562,72 @@ void EPD1in54::setFrameMemory(
  *          from the flash).
  */
 void EPD1in54::setFrameMemory(const unsigned char* image_buffer) {
+  recordWindow(0, 0, this->width - 1, this->height - 1, BANK_DATA_P, 0, image_buffer, 0);
   setMemoryArea(0, 0, this->width - 1, this->height - 1);
   setMemoryPointer(0, 0);
   sendCommand(WRITE_RAM);
   /* send the image data */
-  for (int i = 0; i < this->width / 8 * this->height; i++) {
-    sendData(pgm_read_byte(&image_buffer[i]));
+  dcWrite(HIGH);
+  spiTransferBufferP(image_buffer, this->width / 8 * this->height);
+}
+
+/**
+ *  @brief: put an image buffer in RAM to the frame memory without waiting
+ *          for the data to be sent, see EPDIF::spiTransferBufferAsync().
+ *          the callback is called once the whole buffer has been sent,
+ *          the buffer must not be modified until then.
+ *          a window cut by the edge of the display is sent synchronously
+ *          because its lines are not contiguous in the buffer.
+ *          this won't update the display.
+ */
+int EPD1in54::setFrameMemoryAsync(
+                                  const unsigned char* image_buffer,
+                                  int x,
+                                  int y,
+                                  int image_width,
+                                  int image_height,
+                                  EPDTransferCallback callback,
+                                  void* arg
+                                  ) {
+  int width = (int) this->width;
+  int height = (int) this->height;
+
+  if (
+      image_buffer == NULL ||
+      x < 0 || image_width < 0 ||
+      y < 0 || image_height < 0
+      ) {
+    return -1;
+  }
+  /* x point must be the multiple of 8 or the last 3 bits will be ignored */
+  x &= 0xF8;
+  image_width &= 0xF8;
+  if (x + image_width > width || y + image_height > height) {
+    setFrameMemory(image_buffer, x, y, image_width, image_height);
+    if (callback != NULL) {
+      callback(arg);
+    }
+    return 0;
   }
+  recordWindow(x, y, x + image_width - 1, y + image_height - 1, BANK_DATA, 0, image_buffer, image_width / 8);
+  setMemoryArea(x, y, x + image_width - 1, y + image_height - 1);
+  setMemoryPointer(x, y);
+  sendCommand(WRITE_RAM);
+  dcWrite(HIGH);
+  return spiTransferBufferAsync(image_buffer, image_width / 8 * image_height, callback, arg);
+}
+
+/**
+ *  @brief: put a whole frame in RAM to the frame memory without waiting
+ *          for the data to be sent.
+ *          this won't update the display.
+ */
+int EPD1in54::setFrameMemoryAsync(
+                                  const unsigned char* image_buffer,
+                                  EPDTransferCallback callback,
+                                  void* arg
+                                  ) {
+  return setFrameMemoryAsync(image_buffer, 0, 0, this->width, this->height, callback, arg);
 }
 
 /**
@@ -191,13 +635,13 @@ void EPD1in54::setFrameMemory(const unsigned char* image_buffer) {
  *          this won't update the display.
  */
 void EPD1in54::clearFrameMemory(unsigned char color) {
+  recordWindow(0, 0, this->width - 1, this->height - 1, BANK_FILL, color, NULL, 0);
   setMemoryArea(0, 0, this->width - 1, this->height - 1);
   setMemoryPointer(0, 0);
   sendCommand(WRITE_RAM);
   /* send the color data */
-  for (int i = 0; i < this->width / 8 * this->height; i++) {
-    sendData(color);
-  }
+  dcWrite(HIGH);
+  spiTransferFill(color, this->width / 8 * this->height);
 }
 
 /**
@@ -206,28 +650,437 @@ void EPD1in54::clearFrameMemory(unsigned char color) {
  *          but once this function is called,
  *          the the next action of setFrameMemory or clearFrame will
  *          set the other memory area.
+ *          -1 if the transport failed to send a block since init() or
+ *          the last displayFrame(), see takeWriteError() in EPDTransport.h.
+ */
+int EPD1in54::displayFrame(void) {
+  beginDisplayFrame();
+  waitUntilIdle();
+  return transferFailed() ? -1 : 0;
+}
+
+/**
+ *  @brief: same as displayFrame but returns as soon as the refresh has
+ *          started. call pollDisplayFrame() until it returns
+ *          EPD_FRAME_DONE (or waitUntilIdle()) before sending anything
+ *          else to the module.
  */
-void EPD1in54::displayFrame(void) {
-  sendCommand(DISPLAY_UPDATE_CONTROL_2);
-  sendData(0xC4);
+void EPD1in54::beginDisplayFrame(void) {
+  unsigned char sequence = 0xC4;
+  if (bankScratch != NULL) {
+    /* the windows of this cycle are missing from the other bank */
+    replayBank();
+    bankPrevious = bankCurrent;
+    bankCurrent = 0;
+  }
+  writeRegister(DISPLAY_UPDATE_CONTROL_2, &sequence, 1);
   sendCommand(MASTER_ACTIVATION);
   sendCommand(TERMINATE_FRAME_READ_WRITE);
-  waitUntilIdle();
+  refreshStarted(LOW);
+  busyPending = true;
+  ramBank ^= 1;
+}
+
+/**
+ *  @brief: EPD_FRAME_UPLOADING, EPD_FRAME_REFRESHING or EPD_FRAME_DONE.
+ *          see getRefreshElapsed() and getRefreshProgress() for the time.
+ */
+int EPD1in54::pollDisplayFrame(void) {
+  int status = refreshStatus();
+  if (status == EPD_FRAME_DONE && busyRead() == LOW) {
+    busyPending = false;
+  }
+  return status;
+}
+
+/**
+ *  @brief: keep both RAM banks coherent for partial updates.
+ *          the module shows one bank and the next frame goes to the
+ *          other, so without this a window has to be sent and displayed
+ *          twice. with a scratch buffer every window written is copied
+ *          into it, and at the next refresh the windows of the cycle
+ *          before that are not covered by a new window are sent again,
+ *          so the bank being refreshed holds both.
+ *          the scratch has to hold the windows of two refreshes, each
+ *          with its data and a small header. a window that does not fit
+ *          is not replayed. NULL turns this off.
+ */
+void EPD1in54::setBankScratch(unsigned char* scratch, unsigned int size) {
+  bankScratch = scratch;
+  bankSize = scratch != NULL ? size : 0;
+  bankPrevious = 0;
+  bankCurrent = 0;
+}
+
+/**
+ *  @brief: the RAM bank the next frame is written to, toggled by every
+ *          refresh and 0 after a reset
+ */
+unsigned char EPD1in54::getRamBank(void) {
+  return ramBank;
+}
+
+/**
+ *  @brief: private function to copy a window into the bank scratch.
+ *          when the scratch is full the previous windows are replayed
+ *          at once, before this window is sent, to make room.
+ */
+void EPD1in54::recordWindow(
+                            int x,
+                            int y,
+                            int x_end,
+                            int y_end,
+                            unsigned char kind,
+                            unsigned char color,
+                            const unsigned char* data,
+                            int line_stride
+                            ) {
+  EPDBankWindow window;
+  unsigned int line_bytes = (x_end - x + 1) / 8;
+  unsigned char* record;
+
+  if (bankScratch == NULL) {
+    return;
+  }
+  window.x = x;
+  window.y = y;
+  window.x_end = x_end;
+  window.y_end = y_end;
+  window.kind = kind;
+  window.color = color;
+  window.resent = false;
+  window.data = kind == BANK_DATA_P ? data : NULL;
+  if (bankPrevious + bankCurrent + bankRecordLength(window) > bankSize) {
+    replayBank();
+    if (bankCurrent + bankRecordLength(window) > bankSize) {
+      return;
+    }
+  }
+  record = bankScratch + bankPrevious + bankCurrent;
+  memcpy(record, &window, sizeof(EPDBankWindow));
+  if (kind == BANK_DATA) {
+    for (int j = 0; j <= y_end - y; j++) {
+      memcpy(record + sizeof(EPDBankWindow) + j * line_bytes, data + j * line_stride, line_bytes);
+    }
+  }
+  bankCurrent += bankRecordLength(window);
+}
+
+/**
+ *  @brief: private function to send a window of the bank scratch again
+ */
+void EPD1in54::sendWindow(const unsigned char* record) {
+  EPDBankWindow window;
+  unsigned int length;
+
+  memcpy(&window, record, sizeof(EPDBankWindow));
+  if (window.kind == BANK_STREAM) {
+    return;
+  }
+  length = (window.x_end - window.x + 1) / 8 * (window.y_end - window.y + 1);
+  setMemoryArea(window.x, window.y, window.x_end, window.y_end);
+  setMemoryPointer(window.x, window.y);
+  sendCommand(WRITE_RAM);
+  dcWrite(HIGH);
+  if (window.kind == BANK_FILL) {
+    spiTransferFill(window.color, length);
+  } else if (window.kind == BANK_DATA_P) {
+    spiTransferBufferP(window.data, length);
+  } else {
+    spiTransferBuffer(record + sizeof(EPDBankWindow), length);
+  }
+}
+
+/**
+ *  @brief: private function, true if a window of the previous cycle has
+ *          to be sent again because no new window covers it
+ */
+bool EPD1in54::bankMissing(const EPDBankWindow& window) {
+  EPDBankWindow other;
+  for (unsigned int j = bankPrevious; j < bankPrevious + bankCurrent; j += bankRecordLength(other)) {
+    memcpy(&other, bankScratch + j, sizeof(EPDBankWindow));
+    if (
+        other.x <= window.x && other.x_end >= window.x_end &&
+        other.y <= window.y && other.y_end >= window.y_end
+        ) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+ *  @brief: private function. the windows of the previous cycle are not in
+ *          the bank being written, the ones no new window covers are sent
+ *          again. the new windows they overlap, and the later new windows
+ *          overlapping those, are sent once more after them in their
+ *          order, as they have to stay on top. the previous windows are
+ *          dropped from the scratch afterwards.
+ */
+void EPD1in54::replayBank(void) {
+  EPDBankWindow window;
+  EPDBankWindow other;
+  unsigned int i;
+  unsigned int j;
+  unsigned int end = bankPrevious + bankCurrent;
+
+  for (i = 0; i < bankPrevious; i += bankRecordLength(window)) {
+    memcpy(&window, bankScratch + i, sizeof(EPDBankWindow));
+    window.resent = window.kind != BANK_STREAM && bankMissing(window);
+    if (window.resent) {
+      sendWindow(bankScratch + i);
+    }
+    memcpy(bankScratch + i, &window, sizeof(EPDBankWindow));
+  }
+  for (j = bankPrevious; j < end; j += bankRecordLength(other)) {
+    memcpy(&other, bankScratch + j, sizeof(EPDBankWindow));
+    other.resent = false;
+    /* everything before this window has been sent again */
+    for (i = 0; i < j && !other.resent; i += bankRecordLength(window)) {
+      memcpy(&window, bankScratch + i, sizeof(EPDBankWindow));
+      other.resent = window.resent &&
+                     other.x <= window.x_end && other.x_end >= window.x &&
+                     other.y <= window.y_end && other.y_end >= window.y;
+    }
+    if (other.resent) {
+      sendWindow(bankScratch + j);
+    }
+    memcpy(bankScratch + j, &other, sizeof(EPDBankWindow));
+  }
+  memmove(bankScratch, bankScratch + bankPrevious, bankCurrent);
+  bankPrevious = 0;
+}
+
+/**
+ *  @brief: private function to send a window of a buffer whose lines are
+ *          line_stride bytes apart. x and x_end + 1 are multiples of 8.
+ */
+void EPD1in54::sendFrameWindow(
+                               const unsigned char* buffer,
+                               int line_stride,
+                               int x,
+                               int y,
+                               int x_end,
+                               int y_end
+                               ) {
+  int line_bytes = (x_end - x + 1) / 8;
+  setMemoryArea(x, y, x_end, y_end);
+  setMemoryPointer(x, y);
+  sendCommand(WRITE_RAM);
+  /* send the image data */
+  if (line_bytes == line_stride) {
+    sendDataBlock(buffer, line_bytes * (y_end - y + 1));
+  } else {
+    for (int j = 0; j < y_end - y + 1; j++) {
+      sendDataBlock(&buffer[j * line_stride], line_bytes);
+    }
+  }
+}
+
+/**
+ *  @brief: keep a copy of what the module shows in shadow, a buffer of
+ *          a whole frame (width / 8 * height bytes), for commitFrame().
+ *          tiles holds EPD_DIFF_TILE_WORDS masks of the tiles that
+ *          changed. the next two commits send the whole frame, to
+ *          both RAM banks, as after init() and sleep().
+ *          NULL for either turns this off.
+ */
+void EPD1in54::setFrameShadow(unsigned char* shadow, unsigned long* tiles) {
+  if (shadow == NULL || tiles == NULL) {
+    frameShadow = NULL;
+    diffPrevious = NULL;
+    diffCurrent = NULL;
+    return;
+  }
+  frameShadow = shadow;
+  diffPrevious = tiles;
+  diffCurrent = tiles + EPD_DIFF_TILE_LINES;
+  diffFull = true;
+}
+
+/**
+ *  @brief: show a whole frame in RAM, sending only what differs from the
+ *          frame memory. the frame is compared word by word with the
+ *          shadow (see setFrameShadow()) in tiles of 8 x EPD_DIFF_TILE_ROWS
+ *          pixels. the changed tiles, plus the ones changed by the last
+ *          commit, which the other RAM bank still lacks, are merged into
+ *          at most EPD_DIFF_MAX_WINDOWS windows, sent, and displayed.
+ *          returns the number of windows sent, 0 if nothing changed
+ *          (and the display was not refreshed), -1 without a shadow.
+ *          the frame memory must only be written by commitFrame() while
+ *          a shadow is set.
+ */
+int EPD1in54::commitFrame(const unsigned char* frame) {
+  int height = (int) this->height;
+  int line_bytes = this->width / 8;
+  int tile_lines = (height + EPD_DIFF_TILE_ROWS - 1) / EPD_DIFF_TILE_ROWS;
+  EPDDiffWindow windows[EPD_DIFF_MAX_WINDOWS];
+  int count;
+
+  if (frameShadow == NULL || frame == NULL) {
+    return -1;
+  }
+  /* nothing is known about either bank, nor about the shadow: the first
+     commit sends everything and marks everything as changed, so that the
+     second one sends everything to the other bank as well */
+  for (int i = 0; i < tile_lines; i++) {
+    diffPrevious[i] = diffFull ? ~0UL : diffCurrent[i];
+    diffCurrent[i] = diffFull ? ~0UL : diffTileLine(frame, i);
+  }
+  diffFull = false;
+  count = mergeDiff(windows);
+  for (int i = 0; i < count; i++) {
+    int x = windows[i].x_start * 8;
+    int y = windows[i].y_start * EPD_DIFF_TILE_ROWS;
+    int x_end = windows[i].x_end * 8 + 7;
+    int y_end = windows[i].y_end * EPD_DIFF_TILE_ROWS + EPD_DIFF_TILE_ROWS - 1;
+    if (y_end >= height) {
+      y_end = height - 1;
+    }
+    sendFrameWindow(&frame[y * line_bytes + x / 8], line_bytes, x, y, x_end, y_end);
+    for (int j = y; j <= y_end; j++) {
+      memcpy(&frameShadow[j * line_bytes + x / 8], &frame[j * line_bytes + x / 8], (x_end - x + 1) / 8);
+    }
+  }
+  if (count > 0) {
+    displayFrame();
+  }
+  return count;
+}
+
+/**
+ *  @brief: private function, a bit for every byte column of a line of
+ *          tiles that differs from the shadow
+ */
+unsigned long EPD1in54::diffTileLine(const unsigned char* frame, int tile_line) {
+  int height = (int) this->height;
+  int line_bytes = this->width / 8;
+  int y_end = (tile_line + 1) * EPD_DIFF_TILE_ROWS;
+  unsigned long mask = 0;
+  uint32_t a;
+  uint32_t b;
+  int i;
+
+  if (y_end > height) {
+    y_end = height;
+  }
+  for (int y = tile_line * EPD_DIFF_TILE_ROWS; y < y_end; y++) {
+    const unsigned char* line = &frame[y * line_bytes];
+    const unsigned char* shadow = &frameShadow[y * line_bytes];
+    /* compare 4 bytes at a time, and the bytes of a differing word */
+    for (i = 0; i + 4 <= line_bytes; i += 4) {
+      memcpy(&a, &line[i], 4);
+      memcpy(&b, &shadow[i], 4);
+      if (a != b) {
+        for (int k = i; k < i + 4; k++) {
+          if (line[k] != shadow[k]) {
+            mask |= 1UL << k;
+          }
+        }
+      }
+    }
+    for (; i < line_bytes; i++) {
+      if (line[i] != shadow[i]) {
+        mask |= 1UL << i;
+      }
+    }
+  }
+  return mask;
+}
+
+/**
+ *  @brief: private function to merge the dirty tiles of diffPrevious and
+ *          diffCurrent into windows. runs of tiles in a line become spans,
+ *          spans continuing one of the line above with the same columns
+ *          extend it, and two windows are joined as long as the box around
+ *          them costs less than sending both.
+ */
+int EPD1in54::mergeDiff(EPDDiffWindow* windows) {
+  int tile_lines = (this->height + EPD_DIFF_TILE_ROWS - 1) / EPD_DIFF_TILE_ROWS;
+  int line_bytes = this->width / 8;
+  int count = 0;
+  int merged;
+
+  for (int line = 0; line < tile_lines; line++) {
+    unsigned long mask = diffPrevious[line] | diffCurrent[line];
+    for (int column = 0; column < line_bytes; column++) {
+      int start;
+      int k;
+      if (!(mask & (1UL << column))) {
+        continue;
+      }
+      start = column;
+      while (column + 1 < line_bytes && (mask & (1UL << (column + 1)))) {
+        column++;
+      }
+      /* a window of the line above with the same columns */
+      for (k = 0; k < count; k++) {
+        if (
+            windows[k].x_start == start && windows[k].x_end == column &&
+            windows[k].y_end == line - 1
+            ) {
+          break;
+        }
+      }
+      if (k < count) {
+        windows[k].y_end = line;
+        continue;
+      }
+      if (count == EPD_DIFF_MAX_WINDOWS) {
+        /* no room left, grow the last window instead */
+        k = count - 1;
+        windows[k].x_start = windows[k].x_start < start ? windows[k].x_start : start;
+        windows[k].x_end = windows[k].x_end > column ? windows[k].x_end : column;
+        windows[k].y_end = line;
+        continue;
+      }
+      windows[count].x_start = start;
+      windows[count].x_end = column;
+      windows[count].y_start = line;
+      windows[count].y_end = line;
+      count++;
+    }
+  }
+  /* join the pair that saves the most bytes, until none does */
+  do {
+    long best = 0;
+    int best_a = 0;
+    int best_b = 0;
+    merged = 0;
+    for (int a = 0; a < count; a++) {
+      for (int b = a + 1; b < count; b++) {
+        long saving = diffCost(windows[a]) + diffCost(windows[b]) - diffCost(diffJoin(windows[a], windows[b]));
+        if (saving > best) {
+          best = saving;
+          best_a = a;
+          best_b = b;
+        }
+      }
+    }
+    if (best > 0) {
+      windows[best_a] = diffJoin(windows[best_a], windows[best_b]);
+      windows[best_b] = windows[--count];
+      merged = 1;
+    }
+  } while (merged);
+  return count;
 }
 
 /**
  *  @brief: private function to specify the memory area for data R/W
  */
 void EPD1in54::setMemoryArea(int x_start, int y_start, int x_end, int y_end) {
-  sendCommand(SET_RAM_X_ADDRESS_START_END_POSITION);
+  unsigned char x_range[2];
+  unsigned char y_range[4];
   /* x point must be the multiple of 8 or the last 3 bits will be ignored */
-  sendData((x_start >> 3) & 0xFF);
-  sendData((x_end >> 3) & 0xFF);
-  sendCommand(SET_RAM_Y_ADDRESS_START_END_POSITION);
-  sendData(y_start & 0xFF);
-  sendData((y_start >> 8) & 0xFF);
-  sendData(y_end & 0xFF);
-  sendData((y_end >> 8) & 0xFF);
+  x_range[0] = (x_start >> 3) & 0xFF;
+  x_range[1] = (x_end >> 3) & 0xFF;
+  writeRegister(SET_RAM_X_ADDRESS_START_END_POSITION, x_range, 2);
+  y_range[0] = y_start & 0xFF;
+  y_range[1] = (y_start >> 8) & 0xFF;
+  y_range[2] = y_end & 0xFF;
+  y_range[3] = (y_end >> 8) & 0xFF;
+  writeRegister(SET_RAM_Y_ADDRESS_START_END_POSITION, y_range, 4);
 }
 
 /**
@@ -240,7 +1093,11 @@ void EPD1in54::setMemoryPointer(int x, int y) {
   sendCommand(SET_RAM_Y_ADDRESS_COUNTER);
   sendData(y & 0xFF);
   sendData((y >> 8) & 0xFF);
-  waitUntilIdle();
+  /* the RAM can not be written while a refresh or a reset is running.
+     the windows after the first go out without polling BUSY again */
+  if (busyPending) {
+    waitUntilIdle();
+  }
 }
 
 /**
@@ -252,6 +1109,8 @@ void EPD1in54::setMemoryPointer(int x, int y) {
 void EPD1in54::sleep() {
   sendCommand(DEEP_SLEEP_MODE);
   waitUntilIdle();
+  invalidateShadow();
+  diffFull = true;
 }
 
 const unsigned char lutFullUpdate[] =
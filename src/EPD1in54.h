@@ -28,6 +28,8 @@
 #define EPD1IN54_H
 
 #include "EPDIF.h"
+#include "EPDPaint.h"
+#include "EPDDisplayList.h"
 
 // Default pin assign
 #define RESET_PIN       8
@@ -39,6 +41,22 @@
 #define EPD_WIDTH       200
 #define EPD_HEIGHT      200
 
+// Update modes, see EPD1in54::setUpdateMode()
+#define EPD_UPDATE_FULL         0
+#define EPD_UPDATE_PARTIAL      1
+
+// Frame diff of commitFrame(): rows per tile, most windows sent per commit
+// and the bytes of commands sent along with a window
+#define EPD_DIFF_TILE_ROWS      8
+#define EPD_DIFF_MAX_WINDOWS    16
+#define EPD_DIFF_WINDOW_COST    20
+#define EPD_DIFF_TILE_LINES     ((EPD_HEIGHT + EPD_DIFF_TILE_ROWS - 1) / EPD_DIFF_TILE_ROWS)
+// Tile masks of EPD1in54::setFrameShadow(): two per line of tiles
+#define EPD_DIFF_TILE_WORDS     (2 * EPD_DIFF_TILE_LINES)
+
+// Expected refresh time until one has been measured
+#define EPD1IN54_REFRESH_MS     2000
+
 // EPD1IN54 commands
 #define DRIVER_OUTPUT_CONTROL                       0x01
 #define BOOSTER_SOFT_START_CONTROL                  0x0C
@@ -62,6 +80,18 @@
 #define SET_RAM_Y_ADDRESS_COUNTER                   0x4F
 #define TERMINATE_FRAME_READ_WRITE                  0xFF
 
+/* one image buffer of EPD1in54::setFrameMemory(const EPDWindow*, unsigned int) */
+struct EPDWindow {
+  const unsigned char* image;
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+struct EPDBankWindow;
+struct EPDDiffWindow;
+
 extern const unsigned char lutFullUpdate[];
 extern const unsigned char lutPartialUpdate[];
 
@@ -70,11 +100,23 @@ class EPD1in54 : EPDIF {
   unsigned long width;
   unsigned long height;
 
-  EPD1in54(unsigned int reset = RESET_PIN, unsigned int dc = DC_PIN, unsigned int cs = CS_PIN, unsigned int busy = BUSY_PIN);
+  EPD1in54(unsigned int reset = RESET_PIN, unsigned int dc = DC_PIN, unsigned int cs = CS_PIN, unsigned int busy = BUSY_PIN, unsigned long spi_clock = EPDIF_SPI_CLOCK);
   ~EPD1in54();
+  using EPDIF::setSpiClock;
+  using EPDIF::getSpiClock;
+  using EPDIF::getTransport;
+  using EPDIF::getRefreshElapsed;
+  using EPDIF::getRefreshTime;
+  using EPDIF::getRefreshProgress;
+  using EPDIF::setYieldCallback;
+  using EPDIF::invalidateShadow;
+  unsigned long probeSpiClock(unsigned long max_clock);
   int  init(const unsigned char* lut);
+  void setUpdateMode(int mode);
   void sendCommand(unsigned char command);
   void sendData(unsigned char data);
+  void sendDataBlock(const unsigned char* data, unsigned int len);
+  void sendSequence(const unsigned char* table, unsigned int len);
   void waitUntilIdle(void);
   void reset(void);
   void setFrameMemory(
@@ -85,16 +127,85 @@ class EPD1in54 : EPDIF {
                       int image_height
                       );
   void setFrameMemory(const unsigned char* image_buffer);
+  void setFrameMemory(const EPDWindow* windows, unsigned int count);
+  bool setFrameMemoryDamage(EPDPaint& paint, int x, int y);
+  int  setFrameMemory(const EPDDisplayList& list, EPDPaint& band, unsigned char* spare_image = NULL);
+  int  setFrameMemory(
+                      const EPDRowSource& source,
+                      int x,
+                      int y,
+                      int image_width,
+                      int image_height,
+                      unsigned char* rows,
+                      int row_count
+                      );
+  int  setFrameMemory(const EPDRowSource& source, unsigned char* rows, int row_count);
+  void beginFrameMemory(void);
+  void writeFrameMemory(const unsigned char* data, unsigned int len);
+  int  setFrameMemoryAsync(
+                           const unsigned char* image_buffer,
+                           int x,
+                           int y,
+                           int image_width,
+                           int image_height,
+                           EPDTransferCallback callback,
+                           void* arg
+                           );
+  int  setFrameMemoryAsync(
+                           const unsigned char* image_buffer,
+                           EPDTransferCallback callback,
+                           void* arg
+                           );
   void clearFrameMemory(unsigned char color);
-  void displayFrame(void);
+  int  displayFrame(void);
+  void beginDisplayFrame(void);
+  int  pollDisplayFrame(void);
   void sleep(void);
+  void setBankScratch(unsigned char* scratch, unsigned int size);
+  unsigned char getRamBank(void);
+  void setFrameShadow(unsigned char* shadow, unsigned long* tiles);
+  int  commitFrame(const unsigned char* frame);
 
  private:
   const unsigned char* lut;
+  bool busyPending;
+  unsigned char ramBank;
+  unsigned char* bankScratch;
+  unsigned int bankSize;
+  unsigned int bankPrevious;
+  unsigned int bankCurrent;
+  unsigned char* frameShadow;
+  unsigned long* diffPrevious;
+  unsigned long* diffCurrent;
+  bool diffFull;
 
   void setLut(const unsigned char* lut);
   void setMemoryArea(int x_start, int y_start, int x_end, int y_end);
   void setMemoryPointer(int x, int y);
+  void recordWindow(
+                    int x,
+                    int y,
+                    int x_end,
+                    int y_end,
+                    unsigned char kind,
+                    unsigned char color,
+                    const unsigned char* data,
+                    int line_stride
+                    );
+  void sendFrameWindow(
+                       const unsigned char* buffer,
+                       int line_stride,
+                       int x,
+                       int y,
+                       int x_end,
+                       int y_end
+                       );
+  unsigned long diffTileLine(const unsigned char* frame, int tile_line);
+  int  mergeDiff(EPDDiffWindow* windows);
+  void sendWindow(const unsigned char* record);
+  bool bankMissing(const EPDBankWindow& window);
+  void replayBank(void);
+  static bool checkSpiClock(void* arg);
 };
 
 #endif /* EPD1IN54_H */
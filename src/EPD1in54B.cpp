@@ -27,61 +27,68 @@
 #include <stdlib.h>
 #include "EPD1in54B.h"
 
-const unsigned char lutVcom0[] =
+const unsigned char initSequence[] PROGMEM =
   {
-    0x0E, 0x14, 0x01, 0x0A, 0x06, 0x04, 0x0A, 0x0A,
-    0x0F, 0x03, 0x03, 0x0C, 0x06, 0x0A, 0x00
+    POWER_SETTING, 4, 0x07, 0x00, 0x08, 0x00,
+    BOOSTER_SOFT_START, 3, 0x07, 0x07, 0x07,
+    POWER_ON, EPD_SEQ_WAIT | 0,
+    PANEL_SETTING, 1, 0xcf,
+    VCOM_AND_DATA_INTERVAL_SETTING, 1, 0x17,
+    PLL_CONTROL, 1, 0x39,
+    TCON_RESOLUTION, 3, 0xC8, 0x00, 0xC8,
+    VCM_DC_SETTING_REGISTER, 1, 0x0E
   };
 
-const unsigned char lutW[] =
+const unsigned char lutBwSequence[] PROGMEM =
   {
-    0x0E, 0x14, 0x01, 0x0A, 0x46, 0x04, 0x8A, 0x4A,
-    0x0F, 0x83, 0x43, 0x0C, 0x86, 0x0A, 0x04
+    0x20, 15,         // g vcom
+      0x0E, 0x14, 0x01, 0x0A, 0x06, 0x04, 0x0A, 0x0A,
+      0x0F, 0x03, 0x03, 0x0C, 0x06, 0x0A, 0x00,
+    0x21, 15,         // g ww --
+      0x0E, 0x14, 0x01, 0x0A, 0x46, 0x04, 0x8A, 0x4A,
+      0x0F, 0x83, 0x43, 0x0C, 0x86, 0x0A, 0x04,
+    0x22, 15,         // g bw r
+      0x0E, 0x14, 0x01, 0x8A, 0x06, 0x04, 0x8A, 0x4A,
+      0x0F, 0x83, 0x43, 0x0C, 0x06, 0x4A, 0x04,
+    0x23, 15,         // g wb w
+      0x8E, 0x94, 0x01, 0x8A, 0x06, 0x04, 0x8A, 0x4A,
+      0x0F, 0x83, 0x43, 0x0C, 0x06, 0x0A, 0x04,
+    0x24, 15,         // g bb b
+      0x8E, 0x94, 0x01, 0x8A, 0x06, 0x04, 0x8A, 0x4A,
+      0x0F, 0x83, 0x43, 0x0C, 0x06, 0x0A, 0x04
   };
 
-const unsigned char lutB[] =
+const unsigned char lutRedSequence[] PROGMEM =
   {
-    0x0E, 0x14, 0x01, 0x8A, 0x06, 0x04, 0x8A, 0x4A,
-    0x0F, 0x83, 0x43, 0x0C, 0x06, 0x4A, 0x04
+    0x25, 15,
+      0x03, 0x1D, 0x01, 0x01, 0x08, 0x23, 0x37, 0x37,
+      0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x26, 15,
+      0x83, 0x5D, 0x01, 0x81, 0x48, 0x23, 0x77, 0x77,
+      0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x27, 15,
+      0x03, 0x1D, 0x01, 0x01, 0x08, 0x23, 0x37, 0x37,
+      0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
   };
 
-const unsigned char lutG1[] =
+/* 4 black pixels (1 bit each) expanded to the 2 bits per pixel format */
+const unsigned char blackNibble[] =
   {
-    0x8E, 0x94, 0x01, 0x8A, 0x06, 0x04, 0x8A, 0x4A,
-    0x0F, 0x83, 0x43, 0x0C, 0x06, 0x0A, 0x04
-  };
-
-const unsigned char lutG2[] =
-  {
-    0x8E, 0x94, 0x01, 0x8A, 0x06, 0x04, 0x8A, 0x4A,
-    0x0F, 0x83, 0x43, 0x0C, 0x06, 0x0A, 0x04
-  };
-
-const unsigned char lutVcom1[] =
-  {
-    0x03, 0x1D, 0x01, 0x01, 0x08, 0x23, 0x37, 0x37,
-    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-  };
-
-const unsigned char lutRed0[] =
-  {
-    0x83, 0x5D, 0x01, 0x81, 0x48, 0x23, 0x77, 0x77,
-    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-  };
-
-const unsigned char lutRed1[] =
-  {
-    0x03, 0x1D, 0x01, 0x01, 0x08, 0x23, 0x37, 0x37,
-    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    0x00, 0x03, 0x0C, 0x0F, 0x30, 0x33, 0x3C, 0x3F,
+    0xC0, 0xC3, 0xCC, 0xCF, 0xF0, 0xF3, 0xFC, 0xFF
   };
 
 EPD1in54B::~EPD1in54B() {
 };
 
-EPD1in54B::EPD1in54B(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy)
-  : EPDIF(reset, dc, cs, busy) {
+EPD1in54B::EPD1in54B(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy, unsigned long spi_clock)
+  : EPDIF(reset, dc, cs, busy, spi_clock) {
   width = EPD_WIDTH;
   height = EPD_HEIGHT;
+  refreshTime = EPD1IN54B_REFRESH_MS;
+  uploadCallback = NULL;
+  uploadArg = NULL;
+  framePlane = EPD_PLANE_BLACK;
 };
 
 int EPD1in54B::init(void) {
@@ -90,45 +97,62 @@ int EPD1in54B::init(void) {
     return -1;
   }
   /* EPD hardware init start */
+  /* always reset, which also brings back a module that hung or lost
+     power. the register cache is cleared by it */
   reset();
-  sendCommand(POWER_SETTING);
-  sendData(0x07);
-  sendData(0x00);
-  sendData(0x08);
-  sendData(0x00);
-  sendCommand(BOOSTER_SOFT_START);
-  sendData(0x07);
-  sendData(0x07);
-  sendData(0x07);
-  sendCommand(POWER_ON);
-
-  waitUntilIdle();
-
-  sendCommand(PANEL_SETTING);
-  sendData(0xcf);
-  sendCommand(VCOM_AND_DATA_INTERVAL_SETTING);
-  sendData(0x17);
-  sendCommand(PLL_CONTROL);
-  sendData(0x39);
-  sendCommand(TCON_RESOLUTION);
-  sendData(0xC8);
-  sendData(0x00);
-  sendData(0xC8);
-  sendCommand(VCM_DC_SETTING_REGISTER);
-  sendData(0x0E);
+  sendSequence(initSequence, sizeof(initSequence));
 
   setLutBw();
   setLutRed();
   /* EPD hardware init end */
-
+  if (transferFailed()) {
+    return -1;
+  }
   return 0;
 }
 
+/**
+ *  @brief: find the fastest SPI clock the module and the wiring can
+ *          carry, up to max_clock, and keep it. see EPDIF::probeClock().
+ *          call this before init(), the module is reset afterwards
+ *          because a garbled command may have changed any register.
+ */
+unsigned long EPD1in54B::probeSpiClock(unsigned long max_clock) {
+  unsigned long clock;
+  if (ifInit() != 0) {
+    return getSpiClock();
+  }
+  reset();
+  clock = probeClock(max_clock, checkSpiClock, this);
+  reset();
+  return clock;
+}
+
+/**
+ *  @brief: private clock check for probeSpiClock().
+ *          powering on keeps the busyPin LOW for a while, which only
+ *          happens when the commands arrived intact.
+ */
+bool EPD1in54B::checkSpiClock(void* arg) {
+  EPD1in54B* epd = (EPD1in54B*) arg;
+  bool passed;
+  epd->sendCommand(POWER_SETTING);
+  epd->sendData(0x07);
+  epd->sendData(0x00);
+  epd->sendData(0x08);
+  epd->sendData(0x00);
+  epd->sendCommand(POWER_ON);
+  passed = epd->waitBusyLevel(LOW, 10) && epd->waitBusyLevel(HIGH, EPDIF_PROBE_TIMEOUT_MS);
+  epd->sendCommand(POWER_OFF);
+  epd->waitBusyLevel(HIGH, EPDIF_PROBE_TIMEOUT_MS);
+  return passed;
+}
+
 /**
  *  @brief: basic function for sending commands
  */
 void EPD1in54B::sendCommand(unsigned char command) {
-  digitalWrite(dcPin, LOW);
+  dcWrite(LOW);
   spiTransfer(command);
 }
 
@@ -136,17 +160,30 @@ void EPD1in54B::sendCommand(unsigned char command) {
  *  @brief: basic function for sending data
  */
 void EPD1in54B::sendData(unsigned char data) {
-  digitalWrite(dcPin, HIGH);
+  dcWrite(HIGH);
   spiTransfer(data);
 }
 
+/**
+ *  @brief: send a block of data with DC set once and CS held low
+ */
+void EPD1in54B::sendDataBlock(const unsigned char* data, unsigned int len) {
+  dcWrite(HIGH);
+  spiTransferBuffer(data, len);
+}
+
+/**
+ *  @brief: replay a command table from the flash, see EPDIF::sendSequence()
+ */
+void EPD1in54B::sendSequence(const unsigned char* table, unsigned int len) {
+  EPDIF::sendSequence(table, len, HIGH);
+}
+
 /**
  *  @brief: Wait until the busyPin goes HIGH
  */
 void EPD1in54B::waitUntilIdle(void) {
-  while(digitalRead(busyPin) == 0) {      //0: busy, 1: idle
-    delayMs(100);
-  }
+  waitBusyLevel(HIGH, EPD_WAIT_FOREVER);      //0: busy, 1: idle
 }
 
 /**
@@ -155,9 +192,10 @@ void EPD1in54B::waitUntilIdle(void) {
  *          see EPD1in54B::sleep();
  */
 void EPD1in54B::reset(void) {
-  digitalWrite(resetPin, LOW);                //module reset
+  invalidateShadow();
+  resetWrite(LOW);                //module reset
   delayMs(200);
-  digitalWrite(resetPin, HIGH);
+  resetWrite(HIGH);
   delayMs(200);
 }
 
@@ -165,78 +203,281 @@ void EPD1in54B::reset(void) {
  *  @brief: set the look-up tables
  */
 void EPD1in54B::setLutBw(void) {
-  unsigned int count;
-  sendCommand(0x20);         //g vcom
-  for(count = 0; count < 15; count++) {
-    sendData(lutVcom0[count]);
+  sendSequence(lutBwSequence, sizeof(lutBwSequence));
+}
+
+void EPD1in54B::setLutRed(void) {
+  sendSequence(lutRedSequence, sizeof(lutRedSequence));
+}
+
+/**
+ *  @brief: send the frames to the module without a refresh.
+ *          a NULL frame is left as it is.
+ */
+void EPD1in54B::setFrameMemory(const unsigned char* frame_buffer_black, const unsigned char* frame_buffer_red) {
+  if (frame_buffer_black != NULL) {
+    sendFrameBlack(frame_buffer_black);
   }
-  sendCommand(0x21);        //g ww --
-  for(count = 0; count < 15; count++) {
-    sendData(lutW[count]);
+  if (frame_buffer_red != NULL) {
+    sendCommand(DATA_START_TRANSMISSION_2);
+    delayMs(2);
+    dcWrite(HIGH);
+    spiTransferBufferP(frame_buffer_red, this->width * this->height / 8);
+    delayMs(2);
   }
-  sendCommand(0x22);         //g bw r
-  for(count = 0; count < 15; count++) {
-    sendData(lutB[count]);
+}
+
+/**
+ *  @brief: send the frames and refresh. -1 if the transport failed to
+ *          send a block since init() or the last displayFrame() (every
+ *          displayFrame() checks this), see takeWriteError() in
+ *          EPDTransport.h.
+ */
+int EPD1in54B::displayFrame(const unsigned char* frame_buffer_black, const unsigned char* frame_buffer_red) {
+  setFrameMemory(frame_buffer_black, frame_buffer_red);
+  beginDisplayFrame();
+  waitUntilIdle();
+  return transferFailed() ? -1 : 0;
+}
+
+/**
+ *  @brief: draw the lists into the frames band by band and send them
+ *          without a refresh, see EPD1in54::setFrameMemory(const
+ *          EPDDisplayList&, EPDPaint&, unsigned char*) for band and
+ *          spare_image.
+ *          the black frame is sent as it is drawn, as its pixels
+ *          are expanded on the way. a NULL list leaves its frame as it is.
+ *          -1 if band does not fit the display.
+ */
+int EPD1in54B::setFrameMemory(
+                                 const EPDDisplayList* black,
+                                 const EPDDisplayList* red,
+                                 EPDPaint& band,
+                                 unsigned char* spare_image
+                                 ) {
+  if (black != NULL && sendFramePlane(EPD_PLANE_BLACK, *black, band, spare_image) != 0) {
+    return -1;
   }
-  sendCommand(0x23);         //g wb w
-  for(count = 0; count < 15; count++) {
-    sendData(lutG1[count]);
+  if (red != NULL && sendFramePlane(EPD_PLANE_RED, *red, band, spare_image) != 0) {
+    return -1;
   }
-  sendCommand(0x24);         //g bb b
-  for(count = 0; count < 15; count++) {
-    sendData(lutG2[count]);
+  return 0;
+}
+
+int EPD1in54B::displayFrame(
+                               const EPDDisplayList* black,
+                               const EPDDisplayList* red,
+                               EPDPaint& band,
+                               unsigned char* spare_image
+                               ) {
+  if (setFrameMemory(black, red, band, spare_image) != 0) {
+    return -1;
   }
+  beginDisplayFrame();
+  waitUntilIdle();
+  return transferFailed() ? -1 : 0;
 }
 
-void EPD1in54B::setLutRed(void) {
-  unsigned int count;
-  sendCommand(0x25);
-  for(count = 0; count < 15; count++) {
-    sendData(lutVcom1[count]);
+/**
+ *  @brief: send the frames made by the sources (see EPDRowSource) without
+ *          a refresh. rows is a buffer of row_count lines of width / 8
+ *          bytes that a source fills again and again. a NULL source
+ *          leaves its frame as it is. -1 without a buffer.
+ */
+int EPD1in54B::setFrameMemory(const EPDRowSource* black, const EPDRowSource* red, unsigned char* rows, int row_count) {
+  if (rows == NULL || row_count <= 0) {
+    return -1;
   }
-  sendCommand(0x26);
-  for(count = 0; count < 15; count++) {
-    sendData(lutRed0[count]);
+  if (black != NULL) {
+    sendFramePlane(EPD_PLANE_BLACK, *black, rows, row_count);
+  }
+  if (red != NULL) {
+    sendFramePlane(EPD_PLANE_RED, *red, rows, row_count);
+  }
+  return 0;
+}
+
+int EPD1in54B::displayFrame(const EPDRowSource* black, const EPDRowSource* red, unsigned char* rows, int row_count) {
+  if (setFrameMemory(black, red, rows, row_count) != 0) {
+    return -1;
   }
-  sendCommand(0x27);
-  for(count = 0; count < 15; count++) {
-    sendData(lutRed1[count]);
+  beginDisplayFrame();
+  waitUntilIdle();
+  return transferFailed() ? -1 : 0;
+}
+
+/**
+ *  @brief: start sending a whole frame (EPD_PLANE_BLACK or EPD_PLANE_RED)
+ *          line by line from the top with writeFramePlane(), and finish
+ *          it with endFramePlane(). the data is 1 bit per pixel as for
+ *          setFrameMemory(), in RAM.
+ */
+void EPD1in54B::beginFramePlane(unsigned char plane) {
+  framePlane = plane;
+  sendCommand(plane == EPD_PLANE_RED ? DATA_START_TRANSMISSION_2 : DATA_START_TRANSMISSION_1);
+  delayMs(2);
+}
+
+void EPD1in54B::writeFramePlane(const unsigned char* data, unsigned int len) {
+  if (framePlane == EPD_PLANE_BLACK) {
+    sendBlackPixels(data, len, false);
+  } else {
+    sendDataBlock(data, len);
+  }
+}
+
+void EPD1in54B::endFramePlane(void) {
+  delayMs(2);
+}
+
+/**
+ *  @brief: private function to draw list into a frame band by band
+ */
+int EPD1in54B::sendFramePlane(
+                                 unsigned char plane,
+                                 const EPDDisplayList& list,
+                                 EPDPaint& band,
+                                 unsigned char* spare_image
+                                 ) {
+  unsigned char* images[2] = {band.getImage(), spare_image};
+  int current = 0;
+  int rows = band.getBandHeight();
+  int count;
+
+  if (band.getWidth() != (int) this->width || band.getHeight() != (int) this->height || rows <= 0) {
+    return -1;
+  }
+  beginFramePlane(plane);
+  for (int y = 0; y < (int) this->height; y += rows) {
+    count = (int) this->height - y < rows ? (int) this->height - y : rows;
+    band.setImage(images[current]);
+    band.setBand(y, count);
+    list.render(band);
+    if (spare_image != NULL && plane == EPD_PLANE_RED) {
+      /* this waits for the band before, which used the other buffer */
+      dcWrite(HIGH);
+      spiTransferBufferAsync(images[current], this->width / 8 * count, NULL, NULL);
+      current ^= 1;
+    } else {
+      writeFramePlane(images[current], this->width / 8 * count);
+    }
+  }
+  waitTransfer();
+  endFramePlane();
+  band.setImage(images[0]);
+  band.setBand(0, rows);
+  return 0;
+}
+
+/**
+ *  @brief: private function to send a frame made by source
+ */
+void EPD1in54B::sendFramePlane(unsigned char plane, const EPDRowSource& source, unsigned char* rows, int row_count) {
+  int row_bytes = this->width / 8;
+  int count;
+
+  beginFramePlane(plane);
+  for (int y = 0; y < (int) this->height; y += count) {
+    count = (int) this->height - y < row_count ? (int) this->height - y : row_count;
+    source.fill(rows, y, count, row_bytes, source.arg);
+    writeFramePlane(rows, row_bytes * count);
   }
+  endFramePlane();
+}
+
+/**
+ *  @brief: start the refresh of the frames sent by setFrameMemory() and
+ *          return at once. call pollDisplayFrame() until it returns
+ *          EPD_FRAME_DONE (or waitUntilIdle()) before sending anything
+ *          else to the module.
+ */
+void EPD1in54B::beginDisplayFrame(void) {
+  sendCommand(DISPLAY_REFRESH);
+  refreshStarted(HIGH);
+}
+
+/**
+ *  @brief: EPD_FRAME_UPLOADING, EPD_FRAME_REFRESHING or EPD_FRAME_DONE.
+ *          see getRefreshElapsed() and getRefreshProgress() for the time.
+ */
+int EPD1in54B::pollDisplayFrame(void) {
+  return refreshStatus();
 }
 
-void EPD1in54B::displayFrame(const unsigned char* frame_buffer_black, const unsigned char* frame_buffer_red) {
-  unsigned char temp;
+/**
+ *  @brief: same as displayFrame but the red frame, which has to be in RAM,
+ *          is sent by EPDIF::spiTransferBufferAsync().
+ *          the callback is called once both frames have been sent and
+ *          the refresh has started, call waitUntilIdle() or
+ *          pollDisplayFrame() before sending anything else to the module.
+ *          the red frame must not be modified until the callback is called.
+ */
+int EPD1in54B::displayFrameAsync(
+                                 const unsigned char* frame_buffer_black,
+                                 const unsigned char* frame_buffer_red,
+                                 EPDTransferCallback callback,
+                                 void* arg
+                                 ) {
+  uploadCallback = callback;
+  uploadArg = arg;
   if (frame_buffer_black != NULL) {
-    sendCommand(DATA_START_TRANSMISSION_1);
-    delayMs(2);
-    for (int i = 0; i < this->width * this->height / 8; i++) {
-      temp = 0x00;
-      for (int bit = 0; bit < 4; bit++) {
-        if ((pgm_read_byte(&frame_buffer_black[i]) & (0x80 >> bit)) != 0) {
-          temp |= 0xC0 >> (bit * 2);
-        }
-      }
-      sendData(temp);
-      temp = 0x00;
-      for (int bit = 4; bit < 8; bit++) {
-        if ((pgm_read_byte(&frame_buffer_black[i]) & (0x80 >> bit)) != 0) {
-          temp |= 0xC0 >> ((bit - 4) * 2);
-        }
-      }
-      sendData(temp);
+    sendFrameBlack(frame_buffer_black);
+  }
+  if (frame_buffer_red == NULL) {
+    beginDisplayFrame();
+    if (callback != NULL) {
+      callback(arg);
     }
-    delayMs(2);
+    return 0;
   }
-  if (frame_buffer_red != NULL) {
-    sendCommand(DATA_START_TRANSMISSION_2);
-    delayMs(2);
-    for (int i = 0; i < this->width * this->height / 8; i++) {
-      sendData(pgm_read_byte(&frame_buffer_red[i]));
+  sendCommand(DATA_START_TRANSMISSION_2);
+  delayMs(2);
+  dcWrite(HIGH);
+  return spiTransferBufferAsync(frame_buffer_red, this->width * this->height / 8, redFrameSent, this);
+}
+
+/**
+ *  @brief: private function to send the black frame
+ */
+void EPD1in54B::sendFrameBlack(const unsigned char* frame_buffer_black) {
+  beginFramePlane(EPD_PLANE_BLACK);
+  sendBlackPixels(frame_buffer_black, this->width * this->height / 8, true);
+  endFramePlane();
+}
+
+/**
+ *  @brief: private function to send black pixels in the flash or in RAM.
+ *          every black pixel is sent as 2 bits, so 1 byte becomes 2 bytes
+ */
+void EPD1in54B::sendBlackPixels(const unsigned char* pixels, unsigned int len, bool progmem) {
+  unsigned char chunk[EPDIF_CHUNK_SIZE];
+  unsigned char byte;
+  int count = 0;
+  for (unsigned int i = 0; i < len; i++) {
+    byte = progmem ? pgm_read_byte(&pixels[i]) : pixels[i];
+    chunk[count++] = blackNibble[byte >> 4];
+    chunk[count++] = blackNibble[byte & 0x0F];
+    if (count == EPDIF_CHUNK_SIZE) {
+      sendDataBlock(chunk, count);
+      count = 0;
     }
-    delayMs(2);
   }
-  sendCommand(DISPLAY_REFRESH);
-  waitUntilIdle();
+  if (count > 0) {
+    sendDataBlock(chunk, count);
+  }
+}
+
+/**
+ *  @brief: private completion callback of the asynchronous red frame,
+ *          starts the refresh and calls the callback of the caller
+ */
+void EPD1in54B::redFrameSent(void* arg) {
+  EPD1in54B* epd = (EPD1in54B*) arg;
+  epd->delayMs(2);
+  epd->beginDisplayFrame();
+  if (epd->uploadCallback != NULL) {
+    epd->uploadCallback(epd->uploadArg);
+  }
 }
 
 /**
@@ -259,6 +500,7 @@ void EPD1in54B::sleep() {
   sendData(0x00);
   waitUntilIdle();
   sendCommand(POWER_OFF);         //power off
+  invalidateShadow();
 }
 
 /* END OF FILE */
@@ -28,6 +28,7 @@
 #define EPD1IN54B_H
 
 #include "EPDIF.h"
+#include "EPDDisplayList.h"
 
 // Default pin assign
 #define RESET_PIN       8
@@ -39,6 +40,13 @@
 #define EPD_WIDTH       200
 #define EPD_HEIGHT      200
 
+// Frame planes, see EPD1in54B::beginFramePlane()
+#define EPD_PLANE_BLACK         0
+#define EPD_PLANE_RED           1
+
+// Expected refresh time until one has been measured
+#define EPD1IN54B_REFRESH_MS    8000
+
 // EPD1IN54B commands
 #define PANEL_SETTING                               0x00
 #define POWER_SETTING                               0x01
@@ -75,17 +83,71 @@ class EPD1in54B : EPDIF {
   unsigned long width;
   unsigned long height;
 
-  EPD1in54B(unsigned int reset = RESET_PIN, unsigned int dc = DC_PIN, unsigned int cs = CS_PIN, unsigned int busy = BUSY_PIN);
+  EPD1in54B(unsigned int reset = RESET_PIN, unsigned int dc = DC_PIN, unsigned int cs = CS_PIN, unsigned int busy = BUSY_PIN, unsigned long spi_clock = EPDIF_SPI_CLOCK);
   ~EPD1in54B();
+  using EPDIF::setSpiClock;
+  using EPDIF::getSpiClock;
+  using EPDIF::getTransport;
+  using EPDIF::getRefreshElapsed;
+  using EPDIF::getRefreshTime;
+  using EPDIF::getRefreshProgress;
+  using EPDIF::setYieldCallback;
+  using EPDIF::invalidateShadow;
+  unsigned long probeSpiClock(unsigned long max_clock);
   int  init(void);
   void sendCommand(unsigned char command);
   void sendData(unsigned char data);
+  void sendDataBlock(const unsigned char* data, unsigned int len);
+  void sendSequence(const unsigned char* table, unsigned int len);
   void waitUntilIdle(void);
   void reset(void);
   void setLutBw(void);
   void setLutRed(void);
-  void displayFrame(const unsigned char* frame_buffer_black, const unsigned char* frame_buffer_red);
+  void setFrameMemory(const unsigned char* frame_buffer_black, const unsigned char* frame_buffer_red);
+  int  displayFrame(const unsigned char* frame_buffer_black, const unsigned char* frame_buffer_red);
+  int  setFrameMemory(
+                      const EPDDisplayList* black,
+                      const EPDDisplayList* red,
+                      EPDPaint& band,
+                      unsigned char* spare_image = NULL
+                      );
+  int  displayFrame(
+                    const EPDDisplayList* black,
+                    const EPDDisplayList* red,
+                    EPDPaint& band,
+                    unsigned char* spare_image = NULL
+                    );
+  int  setFrameMemory(const EPDRowSource* black, const EPDRowSource* red, unsigned char* rows, int row_count);
+  int  displayFrame(const EPDRowSource* black, const EPDRowSource* red, unsigned char* rows, int row_count);
+  void beginFramePlane(unsigned char plane);
+  void writeFramePlane(const unsigned char* data, unsigned int len);
+  void endFramePlane(void);
+  void beginDisplayFrame(void);
+  int  pollDisplayFrame(void);
+  int  displayFrameAsync(
+                         const unsigned char* frame_buffer_black,
+                         const unsigned char* frame_buffer_red,
+                         EPDTransferCallback callback,
+                         void* arg
+                         );
   void sleep(void);
+
+ private:
+  EPDTransferCallback uploadCallback;
+  void* uploadArg;
+  unsigned char framePlane;
+
+  void sendFrameBlack(const unsigned char* frame_buffer_black);
+  void sendBlackPixels(const unsigned char* pixels, unsigned int len, bool progmem);
+  static void redFrameSent(void* arg);
+  int  sendFramePlane(
+                      unsigned char plane,
+                      const EPDDisplayList& list,
+                      EPDPaint& band,
+                      unsigned char* spare_image
+                      );
+  void sendFramePlane(unsigned char plane, const EPDRowSource& source, unsigned char* rows, int row_count);
+  static bool checkSpiClock(void* arg);
 };
 
 #endif /* EPD1IN54B_H */
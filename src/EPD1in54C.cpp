@@ -27,61 +27,60 @@
 #include <stdlib.h>
 #include "EPD1in54C.h"
 
-const unsigned char lutVcom0[] =
+const unsigned char initSequence[] PROGMEM =
   {
-    0x0E, 0x14, 0x01, 0x0A, 0x06, 0x04, 0x0A, 0x0A,
-    0x0F, 0x03, 0x03, 0x0C, 0x06, 0x0A, 0x00
+    POWER_SETTING, 4, 0x07, 0x00, 0x08, 0x00,
+    BOOSTER_SOFT_START, 3, 0x17, 0x17, 0x17,
+    POWER_ON, EPD_SEQ_WAIT | 0,
+    PANEL_SETTING, 2, 0x0f, 0x0d,
+    VCOM_AND_DATA_INTERVAL_SETTING, 1, 0xF7,
+    //    PLL_CONTROL, 1, 0x39,
+    TCON_RESOLUTION, 3, 0x98, 0x00, 0x98,
+    VCM_DC_SETTING_REGISTER, 1, 0xf7
   };
 
-const unsigned char lutW[] =
+const unsigned char lutBwSequence[] PROGMEM =
   {
-    0x0E, 0x14, 0x01, 0x0A, 0x46, 0x04, 0x8A, 0x4A,
-    0x0F, 0x83, 0x43, 0x0C, 0x86, 0x0A, 0x04
+    0x20, 15,         // g vcom
+      0x0E, 0x14, 0x01, 0x0A, 0x06, 0x04, 0x0A, 0x0A,
+      0x0F, 0x03, 0x03, 0x0C, 0x06, 0x0A, 0x00,
+    0x21, 15,         // g ww --
+      0x0E, 0x14, 0x01, 0x0A, 0x46, 0x04, 0x8A, 0x4A,
+      0x0F, 0x83, 0x43, 0x0C, 0x86, 0x0A, 0x04,
+    0x22, 15,         // g bw r
+      0x0E, 0x14, 0x01, 0x8A, 0x06, 0x04, 0x8A, 0x4A,
+      0x0F, 0x83, 0x43, 0x0C, 0x06, 0x4A, 0x04,
+    0x23, 15,         // g wb w
+      0x8E, 0x94, 0x01, 0x8A, 0x06, 0x04, 0x8A, 0x4A,
+      0x0F, 0x83, 0x43, 0x0C, 0x06, 0x0A, 0x04,
+    0x24, 15,         // g bb b
+      0x8E, 0x94, 0x01, 0x8A, 0x06, 0x04, 0x8A, 0x4A,
+      0x0F, 0x83, 0x43, 0x0C, 0x06, 0x0A, 0x04
   };
 
-const unsigned char lutB[] =
+const unsigned char lutRedSequence[] PROGMEM =
   {
-    0x0E, 0x14, 0x01, 0x8A, 0x06, 0x04, 0x8A, 0x4A,
-    0x0F, 0x83, 0x43, 0x0C, 0x06, 0x4A, 0x04
-  };
-
-const unsigned char lutG1[] =
-  {
-    0x8E, 0x94, 0x01, 0x8A, 0x06, 0x04, 0x8A, 0x4A,
-    0x0F, 0x83, 0x43, 0x0C, 0x06, 0x0A, 0x04
-  };
-
-const unsigned char lutG2[] =
-  {
-    0x8E, 0x94, 0x01, 0x8A, 0x06, 0x04, 0x8A, 0x4A,
-    0x0F, 0x83, 0x43, 0x0C, 0x06, 0x0A, 0x04
-  };
-
-const unsigned char lutVcom1[] =
-  {
-    0x03, 0x1D, 0x01, 0x01, 0x08, 0x23, 0x37, 0x37,
-    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-  };
-
-const unsigned char lutRed0[] =
-  {
-    0x83, 0x5D, 0x01, 0x81, 0x48, 0x23, 0x77, 0x77,
-    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
-  };
-
-const unsigned char lutRed1[] =
-  {
-    0x03, 0x1D, 0x01, 0x01, 0x08, 0x23, 0x37, 0x37,
-    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+    0x25, 15,
+      0x03, 0x1D, 0x01, 0x01, 0x08, 0x23, 0x37, 0x37,
+      0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x26, 15,
+      0x83, 0x5D, 0x01, 0x81, 0x48, 0x23, 0x77, 0x77,
+      0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x27, 15,
+      0x03, 0x1D, 0x01, 0x01, 0x08, 0x23, 0x37, 0x37,
+      0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
   };
 
 EPD1in54C::~EPD1in54C() {
 };
 
-EPD1in54C::EPD1in54C(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy)
-  : EPDIF(reset, dc, cs, busy) {
+EPD1in54C::EPD1in54C(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy, unsigned long spi_clock)
+  : EPDIF(reset, dc, cs, busy, spi_clock) {
   width = EPD_WIDTH;
   height = EPD_HEIGHT;
+  refreshTime = EPD1IN54C_REFRESH_MS;
+  uploadCallback = NULL;
+  uploadArg = NULL;
 };
 
 int EPD1in54C::init(void) {
@@ -90,46 +89,62 @@ int EPD1in54C::init(void) {
     return -1;
   }
   /* EPD hardware init start */
+  /* always reset, which also brings back a module that hung or lost
+     power. the register cache is cleared by it */
   reset();
-  sendCommand(POWER_SETTING);
-  sendData(0x07);
-  sendData(0x00);
-  sendData(0x08);
-  sendData(0x00);
-  sendCommand(BOOSTER_SOFT_START);
-  sendData(0x17);
-  sendData(0x17);
-  sendData(0x17);
-  sendCommand(POWER_ON);
-
-  waitUntilIdle();
-
-  sendCommand(PANEL_SETTING);
-  sendData(0x0f);
-  sendData(0x0d);
-  sendCommand(VCOM_AND_DATA_INTERVAL_SETTING);
-  sendData(0xF7);
-  //    SendCommand(PLL_CONTROL);
-  //    SendData(0x39);
-  sendCommand(TCON_RESOLUTION);
-  sendData(0x98);
-  sendData(0x00);
-  sendData(0x98);
-  sendCommand(VCM_DC_SETTING_REGISTER);
-  sendData(0xf7);
+  sendSequence(initSequence, sizeof(initSequence));
 
   setLutBw();
   setLutRed();
   /* EPD hardware init end */
-
+  if (transferFailed()) {
+    return -1;
+  }
   return 0;
 }
 
+/**
+ *  @brief: find the fastest SPI clock the module and the wiring can
+ *          carry, up to max_clock, and keep it. see EPDIF::probeClock().
+ *          call this before init(), the module is reset afterwards
+ *          because a garbled command may have changed any register.
+ */
+unsigned long EPD1in54C::probeSpiClock(unsigned long max_clock) {
+  unsigned long clock;
+  if (ifInit() != 0) {
+    return getSpiClock();
+  }
+  reset();
+  clock = probeClock(max_clock, checkSpiClock, this);
+  reset();
+  return clock;
+}
+
+/**
+ *  @brief: private clock check for probeSpiClock().
+ *          powering on keeps the busyPin LOW for a while, which only
+ *          happens when the commands arrived intact.
+ */
+bool EPD1in54C::checkSpiClock(void* arg) {
+  EPD1in54C* epd = (EPD1in54C*) arg;
+  bool passed;
+  epd->sendCommand(POWER_SETTING);
+  epd->sendData(0x07);
+  epd->sendData(0x00);
+  epd->sendData(0x08);
+  epd->sendData(0x00);
+  epd->sendCommand(POWER_ON);
+  passed = epd->waitBusyLevel(LOW, 10) && epd->waitBusyLevel(HIGH, EPDIF_PROBE_TIMEOUT_MS);
+  epd->sendCommand(POWER_OFF);
+  epd->waitBusyLevel(HIGH, EPDIF_PROBE_TIMEOUT_MS);
+  return passed;
+}
+
 /**
  *  @brief: basic function for sending commands
  */
 void EPD1in54C::sendCommand(unsigned char command) {
-  digitalWrite(dcPin, LOW);
+  dcWrite(LOW);
   spiTransfer(command);
 }
 
@@ -137,17 +152,30 @@ void EPD1in54C::sendCommand(unsigned char command) {
  *  @brief: basic function for sending data
  */
 void EPD1in54C::sendData(unsigned char data) {
-  digitalWrite(dcPin, HIGH);
+  dcWrite(HIGH);
   spiTransfer(data);
 }
 
+/**
+ *  @brief: send a block of data with DC set once and CS held low
+ */
+void EPD1in54C::sendDataBlock(const unsigned char* data, unsigned int len) {
+  dcWrite(HIGH);
+  spiTransferBuffer(data, len);
+}
+
+/**
+ *  @brief: replay a command table from the flash, see EPDIF::sendSequence()
+ */
+void EPD1in54C::sendSequence(const unsigned char* table, unsigned int len) {
+  EPDIF::sendSequence(table, len, HIGH);
+}
+
 /**
  *  @brief: Wait until the busyPin goes HIGH
  */
 void EPD1in54C::waitUntilIdle(void) {
-  while(digitalRead(busyPin) == 0) {      //0: busy, 1: idle
-    delayMs(100);
-  }
+  waitBusyLevel(HIGH, EPD_WAIT_FOREVER);      //0: busy, 1: idle
 }
 
 /**
@@ -156,9 +184,10 @@ void EPD1in54C::waitUntilIdle(void) {
  *          see EPD1in54C::sleep();
  */
 void EPD1in54C::reset(void) {
-  digitalWrite(resetPin, LOW);                //module reset
+  invalidateShadow();
+  resetWrite(LOW);                //module reset
   delayMs(200);
-  digitalWrite(resetPin, HIGH);
+  resetWrite(HIGH);
   delayMs(200);
 }
 
@@ -166,64 +195,254 @@ void EPD1in54C::reset(void) {
  *  @brief: set the look-up tables
  */
 void EPD1in54C::setLutBw(void) {
-  unsigned int count;
-  sendCommand(0x20);         //g vcom
-  for(count = 0; count < 15; count++) {
-    sendData(lutVcom0[count]);
+  sendSequence(lutBwSequence, sizeof(lutBwSequence));
+}
+
+void EPD1in54C::setLutRed(void) {
+  sendSequence(lutRedSequence, sizeof(lutRedSequence));
+}
+
+/**
+ *  @brief: send the frames to the module without a refresh.
+ *          a NULL frame is left as it is.
+ */
+void EPD1in54C::setFrameMemory(const unsigned char* frame_buffer_black, const unsigned char* frame_buffer_red) {
+  if (frame_buffer_black != NULL) {
+    sendFrameBlack(frame_buffer_black);
+  }
+  if (frame_buffer_red != NULL) {
+    sendCommand(DATA_START_TRANSMISSION_2);
+    delayMs(2);
+    dcWrite(HIGH);
+    spiTransferBufferP(frame_buffer_red, this->width * this->height / 8);
+    delayMs(2);
+  }
+}
+
+/**
+ *  @brief: send the frames and refresh. -1 if the transport failed to
+ *          send a block since init() or the last displayFrame() (every
+ *          displayFrame() checks this), see takeWriteError() in
+ *          EPDTransport.h.
+ */
+int EPD1in54C::displayFrame(const unsigned char* frame_buffer_black, const unsigned char* frame_buffer_red) {
+  setFrameMemory(frame_buffer_black, frame_buffer_red);
+  beginDisplayFrame();
+  waitUntilIdle();
+  return transferFailed() ? -1 : 0;
+}
+
+/**
+ *  @brief: draw the lists into the frames band by band and send them
+ *          without a refresh, see EPD1in54::setFrameMemory(const
+ *          EPDDisplayList&, EPDPaint&, unsigned char*) for band and
+ *          spare_image. a NULL list leaves its frame as it is.
+ *          -1 if band does not fit the display.
+ */
+int EPD1in54C::setFrameMemory(
+                                 const EPDDisplayList* black,
+                                 const EPDDisplayList* red,
+                                 EPDPaint& band,
+                                 unsigned char* spare_image
+                                 ) {
+  if (black != NULL && sendFramePlane(EPD_PLANE_BLACK, *black, band, spare_image) != 0) {
+    return -1;
+  }
+  if (red != NULL && sendFramePlane(EPD_PLANE_RED, *red, band, spare_image) != 0) {
+    return -1;
   }
-  sendCommand(0x21);        //g ww --
-  for(count = 0; count < 15; count++) {
-    sendData(lutW[count]);
+  return 0;
+}
+
+int EPD1in54C::displayFrame(
+                               const EPDDisplayList* black,
+                               const EPDDisplayList* red,
+                               EPDPaint& band,
+                               unsigned char* spare_image
+                               ) {
+  if (setFrameMemory(black, red, band, spare_image) != 0) {
+    return -1;
   }
-  sendCommand(0x22);         //g bw r
-  for(count = 0; count < 15; count++) {
-    sendData(lutB[count]);
+  beginDisplayFrame();
+  waitUntilIdle();
+  return transferFailed() ? -1 : 0;
+}
+
+/**
+ *  @brief: send the frames made by the sources (see EPDRowSource) without
+ *          a refresh. rows is a buffer of row_count lines of width / 8
+ *          bytes that a source fills again and again. a NULL source
+ *          leaves its frame as it is. -1 without a buffer.
+ */
+int EPD1in54C::setFrameMemory(const EPDRowSource* black, const EPDRowSource* red, unsigned char* rows, int row_count) {
+  if (rows == NULL || row_count <= 0) {
+    return -1;
   }
-  sendCommand(0x23);         //g wb w
-  for(count = 0; count < 15; count++) {
-    sendData(lutG1[count]);
+  if (black != NULL) {
+    sendFramePlane(EPD_PLANE_BLACK, *black, rows, row_count);
   }
-  sendCommand(0x24);         //g bb b
-  for(count = 0; count < 15; count++) {
-    sendData(lutG2[count]);
+  if (red != NULL) {
+    sendFramePlane(EPD_PLANE_RED, *red, rows, row_count);
   }
+  return 0;
 }
 
-void EPD1in54C::setLutRed(void) {
-  unsigned int count;
-  sendCommand(0x25);
-  for(count = 0; count < 15; count++) {
-    sendData(lutVcom1[count]);
+int EPD1in54C::displayFrame(const EPDRowSource* black, const EPDRowSource* red, unsigned char* rows, int row_count) {
+  if (setFrameMemory(black, red, rows, row_count) != 0) {
+    return -1;
   }
-  sendCommand(0x26);
-  for(count = 0; count < 15; count++) {
-    sendData(lutRed0[count]);
+  beginDisplayFrame();
+  waitUntilIdle();
+  return transferFailed() ? -1 : 0;
+}
+
+/**
+ *  @brief: start sending a whole frame (EPD_PLANE_BLACK or EPD_PLANE_RED)
+ *          line by line from the top with writeFramePlane(), and finish
+ *          it with endFramePlane(). the data is 1 bit per pixel as for
+ *          setFrameMemory(), in RAM.
+ */
+void EPD1in54C::beginFramePlane(unsigned char plane) {
+  sendCommand(plane == EPD_PLANE_RED ? DATA_START_TRANSMISSION_2 : DATA_START_TRANSMISSION_1);
+  delayMs(2);
+}
+
+void EPD1in54C::writeFramePlane(const unsigned char* data, unsigned int len) {
+  sendDataBlock(data, len);
+}
+
+void EPD1in54C::endFramePlane(void) {
+  delayMs(2);
+}
+
+/**
+ *  @brief: private function to draw list into a frame band by band
+ */
+int EPD1in54C::sendFramePlane(
+                                 unsigned char plane,
+                                 const EPDDisplayList& list,
+                                 EPDPaint& band,
+                                 unsigned char* spare_image
+                                 ) {
+  unsigned char* images[2] = {band.getImage(), spare_image};
+  int current = 0;
+  int rows = band.getBandHeight();
+  int count;
+
+  if (band.getWidth() != (int) this->width || band.getHeight() != (int) this->height || rows <= 0) {
+    return -1;
+  }
+  beginFramePlane(plane);
+  for (int y = 0; y < (int) this->height; y += rows) {
+    count = (int) this->height - y < rows ? (int) this->height - y : rows;
+    band.setImage(images[current]);
+    band.setBand(y, count);
+    list.render(band);
+    if (spare_image != NULL) {
+      /* this waits for the band before, which used the other buffer */
+      dcWrite(HIGH);
+      spiTransferBufferAsync(images[current], this->width / 8 * count, NULL, NULL);
+      current ^= 1;
+    } else {
+      writeFramePlane(images[current], this->width / 8 * count);
+    }
   }
-  sendCommand(0x27);
-  for(count = 0; count < 15; count++) {
-    sendData(lutRed1[count]);
+  waitTransfer();
+  endFramePlane();
+  band.setImage(images[0]);
+  band.setBand(0, rows);
+  return 0;
+}
+
+/**
+ *  @brief: private function to send a frame made by source
+ */
+void EPD1in54C::sendFramePlane(unsigned char plane, const EPDRowSource& source, unsigned char* rows, int row_count) {
+  int row_bytes = this->width / 8;
+  int count;
+
+  beginFramePlane(plane);
+  for (int y = 0; y < (int) this->height; y += count) {
+    count = (int) this->height - y < row_count ? (int) this->height - y : row_count;
+    source.fill(rows, y, count, row_bytes, source.arg);
+    writeFramePlane(rows, row_bytes * count);
   }
+  endFramePlane();
+}
+
+/**
+ *  @brief: start the refresh of the frames sent by setFrameMemory() and
+ *          return at once. call pollDisplayFrame() until it returns
+ *          EPD_FRAME_DONE (or waitUntilIdle()) before sending anything
+ *          else to the module.
+ */
+void EPD1in54C::beginDisplayFrame(void) {
+  sendCommand(DISPLAY_REFRESH);
+  refreshStarted(HIGH);
 }
 
-void EPD1in54C::displayFrame(const unsigned char* frame_buffer_black, const unsigned char* frame_buffer_red) {
+/**
+ *  @brief: EPD_FRAME_UPLOADING, EPD_FRAME_REFRESHING or EPD_FRAME_DONE.
+ *          see getRefreshElapsed() and getRefreshProgress() for the time.
+ */
+int EPD1in54C::pollDisplayFrame(void) {
+  return refreshStatus();
+}
+
+/**
+ *  @brief: same as displayFrame but the red frame, which has to be in RAM,
+ *          is sent by EPDIF::spiTransferBufferAsync().
+ *          the callback is called once both frames have been sent and
+ *          the refresh has started, call waitUntilIdle() or
+ *          pollDisplayFrame() before sending anything else to the module.
+ *          the red frame must not be modified until the callback is called.
+ */
+int EPD1in54C::displayFrameAsync(
+                                 const unsigned char* frame_buffer_black,
+                                 const unsigned char* frame_buffer_red,
+                                 EPDTransferCallback callback,
+                                 void* arg
+                                 ) {
+  uploadCallback = callback;
+  uploadArg = arg;
   if (frame_buffer_black != NULL) {
-    sendCommand(DATA_START_TRANSMISSION_1);
-    delayMs(2);
-    for (int i = 0; i < this->width * this->height / 8; i++) {
-      sendData(pgm_read_byte(&frame_buffer_black[i]));
-    }
-    delayMs(2);
+    sendFrameBlack(frame_buffer_black);
   }
-  if (frame_buffer_red != NULL) {
-    sendCommand(DATA_START_TRANSMISSION_2);
-    delayMs(2);
-    for (int i = 0; i < this->width * this->height / 8; i++) {
-      sendData(pgm_read_byte(&frame_buffer_red[i]));
+  if (frame_buffer_red == NULL) {
+    beginDisplayFrame();
+    if (callback != NULL) {
+      callback(arg);
     }
-    delayMs(2);
+    return 0;
+  }
+  sendCommand(DATA_START_TRANSMISSION_2);
+  delayMs(2);
+  dcWrite(HIGH);
+  return spiTransferBufferAsync(frame_buffer_red, this->width * this->height / 8, redFrameSent, this);
+}
+
+/**
+ *  @brief: private function to send the black frame
+ */
+void EPD1in54C::sendFrameBlack(const unsigned char* frame_buffer_black) {
+  sendCommand(DATA_START_TRANSMISSION_1);
+  delayMs(2);
+  dcWrite(HIGH);
+  spiTransferBufferP(frame_buffer_black, this->width * this->height / 8);
+  delayMs(2);
+}
+
+/**
+ *  @brief: private completion callback of the asynchronous red frame,
+ *          starts the refresh and calls the callback of the caller
+ */
+void EPD1in54C::redFrameSent(void* arg) {
+  EPD1in54C* epd = (EPD1in54C*) arg;
+  epd->delayMs(2);
+  epd->beginDisplayFrame();
+  if (epd->uploadCallback != NULL) {
+    epd->uploadCallback(epd->uploadArg);
   }
-  sendCommand(DISPLAY_REFRESH);
-  waitUntilIdle();
 }
 
 /**
@@ -246,6 +465,7 @@ void EPD1in54C::sleep() {
   sendData(0x00);
   waitUntilIdle();
   sendCommand(POWER_OFF);         //power off
+  invalidateShadow();
 }
 
 /* END OF FILE */
@@ -0,0 +1,313 @@
+/**
+ *  @filename   :   EPDDisplayList.cpp
+ *  @brief      :   Records drawing calls and replays them band by band
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "EPDDisplayList.h"
+
+// Drawing calls, kept in the low 7 bits of the first byte of a call.
+// the high bit is the color
+#define LIST_CLEAR                  0
+#define LIST_PIXEL                  1
+#define LIST_STRING                 2
+#define LIST_LINE                   3
+#define LIST_HORIZONTAL_LINE        4
+#define LIST_VERTICAL_LINE          5
+#define LIST_RECTANGLE              6
+#define LIST_FILLED_RECTANGLE       7
+#define LIST_CIRCLE                 8
+#define LIST_FILLED_CIRCLE          9
+#define LIST_BITMAP                 10
+
+/* coordinates are kept as 2 bytes, lower byte first */
+static unsigned char* putWord(unsigned char* p, int value) {
+  p[0] = value & 0xFF;
+  p[1] = (value >> 8) & 0xFF;
+  return p + 2;
+}
+
+static int getWord(const unsigned char* p) {
+  return (short) (p[0] | (p[1] << 8));
+}
+
+EPDDisplayList::EPDDisplayList(unsigned char* buffer, unsigned int size) {
+  this->buffer = buffer;
+  this->size = size;
+  reset();
+}
+
+EPDDisplayList::~EPDDisplayList() {
+}
+
+/**
+ *  @brief: forget every call, to record the next frame
+ */
+void EPDDisplayList::reset(void) {
+  this->length = 0;
+  this->overflow = false;
+}
+
+/**
+ *  @brief: the bytes of the buffer used
+ */
+unsigned int EPDDisplayList::getLength(void) const {
+  return this->length;
+}
+
+/**
+ *  @brief: true if a call did not fit into the buffer since the last
+ *          reset(). that call and every one after it were dropped.
+ */
+bool EPDDisplayList::isOverflow(void) const {
+  return this->overflow;
+}
+
+/**
+ *  @brief: the calls, see the ones of EPDPaint of the same name.
+ *          false if the call did not fit into the buffer.
+ */
+bool EPDDisplayList::clear(int colored) {
+  return add(LIST_CLEAR, colored, 0) != NULL;
+}
+
+bool EPDDisplayList::drawPixel(int x, int y, int colored) {
+  unsigned char* p = add(LIST_PIXEL, colored, 4);
+  if (p == NULL) {
+    return false;
+  }
+  p = putWord(p, x);
+  putWord(p, y);
+  return true;
+}
+
+bool EPDDisplayList::drawStringAt(int x, int y, const char* text, sFONT* font, int colored) {
+  unsigned int text_length = strlen(text) + 1;
+  unsigned char* p = add(LIST_STRING, colored, 4 + sizeof(sFONT*) + text_length);
+  if (p == NULL) {
+    return false;
+  }
+  p = putWord(p, x);
+  p = putWord(p, y);
+  memcpy(p, &font, sizeof(sFONT*));
+  memcpy(p + sizeof(sFONT*), text, text_length);
+  return true;
+}
+
+bool EPDDisplayList::drawLine(int x0, int y0, int x1, int y1, int colored) {
+  unsigned char* p = add(LIST_LINE, colored, 8);
+  if (p == NULL) {
+    return false;
+  }
+  p = putWord(p, x0);
+  p = putWord(p, y0);
+  p = putWord(p, x1);
+  putWord(p, y1);
+  return true;
+}
+
+bool EPDDisplayList::drawHorizontalLine(int x, int y, int width, int colored) {
+  unsigned char* p = add(LIST_HORIZONTAL_LINE, colored, 6);
+  if (p == NULL) {
+    return false;
+  }
+  p = putWord(p, x);
+  p = putWord(p, y);
+  putWord(p, width);
+  return true;
+}
+
+bool EPDDisplayList::drawVerticalLine(int x, int y, int height, int colored) {
+  unsigned char* p = add(LIST_VERTICAL_LINE, colored, 6);
+  if (p == NULL) {
+    return false;
+  }
+  p = putWord(p, x);
+  p = putWord(p, y);
+  putWord(p, height);
+  return true;
+}
+
+bool EPDDisplayList::drawRectangle(int x0, int y0, int x1, int y1, int colored) {
+  unsigned char* p = add(LIST_RECTANGLE, colored, 8);
+  if (p == NULL) {
+    return false;
+  }
+  p = putWord(p, x0);
+  p = putWord(p, y0);
+  p = putWord(p, x1);
+  putWord(p, y1);
+  return true;
+}
+
+bool EPDDisplayList::drawFilledRectangle(int x0, int y0, int x1, int y1, int colored) {
+  unsigned char* p = add(LIST_FILLED_RECTANGLE, colored, 8);
+  if (p == NULL) {
+    return false;
+  }
+  p = putWord(p, x0);
+  p = putWord(p, y0);
+  p = putWord(p, x1);
+  putWord(p, y1);
+  return true;
+}
+
+bool EPDDisplayList::drawCircle(int x, int y, int radius, int colored) {
+  unsigned char* p = add(LIST_CIRCLE, colored, 6);
+  if (p == NULL) {
+    return false;
+  }
+  p = putWord(p, x);
+  p = putWord(p, y);
+  putWord(p, radius);
+  return true;
+}
+
+bool EPDDisplayList::drawFilledCircle(int x, int y, int radius, int colored) {
+  unsigned char* p = add(LIST_FILLED_CIRCLE, colored, 6);
+  if (p == NULL) {
+    return false;
+  }
+  p = putWord(p, x);
+  p = putWord(p, y);
+  putWord(p, radius);
+  return true;
+}
+
+bool EPDDisplayList::drawBitmapAt(int x, int y, const unsigned char* bitmap, int bitmap_width, int bitmap_height, int colored) {
+  unsigned char* p = add(LIST_BITMAP, colored, 8 + sizeof(const unsigned char*));
+  if (p == NULL) {
+    return false;
+  }
+  p = putWord(p, x);
+  p = putWord(p, y);
+  p = putWord(p, bitmap_width);
+  p = putWord(p, bitmap_height);
+  memcpy(p, &bitmap, sizeof(const unsigned char*));
+  return true;
+}
+
+/**
+ *  @brief: replay the calls on paint. a call that can not reach the band
+ *          of paint (see EPDPaint::setBand()) is skipped.
+ */
+void EPDDisplayList::render(EPDPaint& paint) const {
+  const unsigned char* p = this->buffer;
+  const unsigned char* end = this->buffer + this->length;
+  unsigned char command;
+  int colored;
+  int a, b, c, d;
+
+  while (p < end) {
+    command = *p & 0x7F;
+    colored = *p >> 7;
+    p++;
+    if (command == LIST_CLEAR) {
+      paint.clear(colored);
+      continue;
+    }
+    a = getWord(p);
+    b = getWord(p + 2);
+    p += 4;
+    if (command == LIST_PIXEL) {
+      if (paint.bandIntersects(a, b, a, b)) {
+        paint.drawPixel(a, b, colored);
+      }
+    } else if (command == LIST_STRING) {
+      sFONT* font;
+      const char* text;
+      memcpy(&font, p, sizeof(sFONT*));
+      text = (const char*) p + sizeof(sFONT*);
+      c = strlen(text);
+      if (paint.bandIntersects(a, b, a + c * font->Width - 1, b + font->Height - 1)) {
+        paint.drawStringAt(a, b, text, font, colored);
+      }
+      p += sizeof(sFONT*) + c + 1;
+    } else if (command == LIST_BITMAP) {
+      const unsigned char* bitmap;
+      c = getWord(p);
+      d = getWord(p + 2);
+      memcpy(&bitmap, p + 4, sizeof(const unsigned char*));
+      if (paint.bandIntersects(a, b, a + c - 1, b + d - 1)) {
+        paint.drawBitmapAt(a, b, bitmap, c, d, colored);
+      }
+      p += 4 + sizeof(const unsigned char*);
+    } else if (command == LIST_HORIZONTAL_LINE || command == LIST_VERTICAL_LINE) {
+      c = getWord(p);
+      p += 2;
+      if (command == LIST_HORIZONTAL_LINE && paint.bandIntersects(a, b, a + c - 1, b)) {
+        paint.drawHorizontalLine(a, b, c, colored);
+      } else if (command == LIST_VERTICAL_LINE && paint.bandIntersects(a, b, a, b + c - 1)) {
+        paint.drawVerticalLine(a, b, c, colored);
+      }
+    } else if (command == LIST_CIRCLE || command == LIST_FILLED_CIRCLE) {
+      c = getWord(p);
+      p += 2;
+      if (!paint.bandIntersects(a - c, b - c, a + c, b + c)) {
+        continue;
+      }
+      if (command == LIST_CIRCLE) {
+        paint.drawCircle(a, b, c, colored);
+      } else {
+        paint.drawFilledCircle(a, b, c, colored);
+      }
+    } else {
+      c = getWord(p);
+      d = getWord(p + 2);
+      p += 4;
+      if (
+          !paint.bandIntersects(
+                                a < c ? a : c,
+                                b < d ? b : d,
+                                a > c ? a : c,
+                                b > d ? b : d
+                                )
+          ) {
+        continue;
+      }
+      if (command == LIST_LINE) {
+        paint.drawLine(a, b, c, d, colored);
+      } else if (command == LIST_RECTANGLE) {
+        paint.drawRectangle(a, b, c, d, colored);
+      } else {
+        paint.drawFilledRectangle(a, b, c, d, colored);
+      }
+    }
+  }
+}
+
+/**
+ *  @brief: private function to make room for a call with len bytes of
+ *          arguments, NULL if it does not fit
+ */
+unsigned char* EPDDisplayList::add(unsigned char command, int colored, unsigned int len) {
+  unsigned char* p;
+  if (this->overflow || this->length + 1 + len > this->size) {
+    this->overflow = true;
+    return NULL;
+  }
+  p = this->buffer + this->length;
+  *p = command | (colored ? 0x80 : 0);
+  this->length += 1 + len;
+  return p + 1;
+}
+
+/* END OF FILE */
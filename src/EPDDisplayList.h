@@ -0,0 +1,70 @@
+/**
+ *  @filename   :   EPDDisplayList.h
+ *  @brief      :   Header file for EPDDisplayList.cpp
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef EPDDISPLAYLIST_H
+#define EPDDISPLAYLIST_H
+
+#include "EPDPaint.h"
+
+/**
+ *  the drawing calls of a frame kept in a small buffer, so that a frame
+ *  can be drawn band by band into an EPDPaint holding only a few rows
+ *  (see EPDPaint::setBand()) and sent to the module while it is drawn,
+ *  e.g. with EPD1in54::setFrameMemory(const EPDDisplayList&, EPDPaint&).
+ *  a call takes 1 byte and 2 bytes per coordinate, a string its
+ *  characters as well. the fonts and bitmaps are not copied and have to
+ *  stay in the flash. start a frame with clear(), every band is drawn
+ *  from scratch.
+ */
+class EPDDisplayList {
+ public:
+  EPDDisplayList(unsigned char* buffer, unsigned int size);
+  ~EPDDisplayList();
+  void reset(void);
+  unsigned int getLength(void) const;
+  bool isOverflow(void) const;
+  bool clear(int colored);
+  bool drawPixel(int x, int y, int colored);
+  bool drawStringAt(int x, int y, const char* text, sFONT* font, int colored);
+  bool drawLine(int x0, int y0, int x1, int y1, int colored);
+  bool drawHorizontalLine(int x, int y, int width, int colored);
+  bool drawVerticalLine(int x, int y, int height, int colored);
+  bool drawRectangle(int x0, int y0, int x1, int y1, int colored);
+  bool drawFilledRectangle(int x0, int y0, int x1, int y1, int colored);
+  bool drawCircle(int x, int y, int radius, int colored);
+  bool drawFilledCircle(int x, int y, int radius, int colored);
+  bool drawBitmapAt(int x, int y, const unsigned char* bitmap, int bitmap_width, int bitmap_height, int colored);
+  void render(EPDPaint& paint) const;
+
+ private:
+  unsigned char* buffer;
+  unsigned int size;
+  unsigned int length;
+  bool overflow;
+
+  unsigned char* add(unsigned char command, int colored, unsigned int len);
+};
+
+#endif
+
+/* END OF FILE */
@@ -0,0 +1,389 @@
+/**
+ *  @filename   :   EPDDisplayService.cpp
+ *  @brief      :   Shows frames and shares the drawing from a task of its own
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "EPDDisplayService.h"
+#if defined(EPD_SERVICE_THREAD)
+#include <chrono>
+#endif
+
+// Jobs of the service task, in the order they are taken
+#define SERVICE_RENDER      0x01
+#define SERVICE_FRAME       0x02
+#define SERVICE_STOP        0x04
+
+/* the clock of the drawing time. the virtual clock of the host build
+   does not move while drawing, so the one of the C++ library is used
+   along with std::thread */
+static unsigned long serviceMicros(void) {
+#if defined(EPD_SERVICE_THREAD)
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+           std::chrono::steady_clock::now().time_since_epoch()
+         ).count();
+#else
+  return micros();
+#endif
+}
+
+EPDDisplayService::EPDDisplayService(EPD1in54& epd) : epd(epd) {
+  running = false;
+  jobs = 0;
+  active = 0;
+  frame = NULL;
+  renderList = NULL;
+  renderPaint = NULL;
+  glyphCache = NULL;
+  renderUs = 0;
+  memset(&stats, 0, sizeof(stats));
+#if defined(ESP32)
+  task = NULL;
+  mutex = NULL;
+  done = NULL;
+#endif
+}
+
+EPDDisplayService::~EPDDisplayService() {
+  end();
+}
+
+/**
+ *  @brief: start the service task. -1 if it can not be started or there
+ *          are no tasks on this board, submit() and render() then run on
+ *          the caller.
+ */
+int EPDDisplayService::begin(void) {
+  if (running) {
+    return 0;
+  }
+  jobs = 0;
+  active = 0;
+#if defined(ESP32)
+  if (mutex == NULL) {
+    mutex = xSemaphoreCreateMutex();
+    if (mutex == NULL) {
+      return -1;
+    }
+  }
+  if (done == NULL) {
+    done = xSemaphoreCreateBinary();
+    if (done == NULL) {
+      return -1;
+    }
+  }
+  if (xTaskCreatePinnedToCore(
+                              taskBody,
+                              "EPDService",
+                              EPD_SERVICE_STACK_SIZE,
+                              this,
+                              EPD_SERVICE_PRIORITY,
+                              &task,
+                              EPD_SERVICE_CORE
+                              ) != pdPASS) {
+    task = NULL;
+    return -1;
+  }
+#elif defined(EPD_SERVICE_THREAD)
+  thread = std::thread(taskBody, this);
+#else
+  return -1;
+#endif
+  running = true;
+  return 0;
+}
+
+/**
+ *  @brief: stop the service task after the frame it is showing
+ */
+void EPDDisplayService::end(void) {
+  if (!running) {
+    return;
+  }
+  post(SERVICE_STOP);
+  waitJobs(SERVICE_STOP);
+#if defined(EPD_SERVICE_THREAD)
+  thread.join();
+#endif
+  running = false;
+}
+
+/**
+ *  @brief: show a whole frame in RAM (width / 8 * height bytes) and
+ *          return at once. the frame must not be modified until the
+ *          service is idle again, draw the next one into another buffer.
+ *          false if the frame before is still being shown.
+ */
+bool EPDDisplayService::submit(const unsigned char* frame) {
+  if (!running) {
+    showFrame(frame);
+    return true;
+  }
+  lock();
+  if ((jobs | active) & SERVICE_FRAME) {
+    unlock();
+    return false;
+  }
+  this->frame = frame;
+  unlock();
+  post(SERVICE_FRAME);
+  return true;
+}
+
+/**
+ *  @brief: true if the service task has nothing to do
+ */
+bool EPDDisplayService::isIdle(void) {
+  bool idle;
+  lock();
+  idle = (jobs | active) == 0;
+  unlock();
+  return idle;
+}
+
+/**
+ *  @brief: wait until the submitted frame has been shown
+ */
+void EPDDisplayService::waitIdle(void) {
+  waitJobs(SERVICE_RENDER | SERVICE_FRAME);
+}
+
+/**
+ *  @brief: draw list on the rows of the band of paint (see
+ *          EPDPaint::setBand()). while the service task has nothing to do
+ *          it draws the lower half of the rows and the caller the upper
+ *          half, which are different bytes of the image. otherwise the
+ *          caller draws everything. the caller draws with the glyph cache
+ *          of paint, the task with the one of setGlyphCache().
+ *          the damage of paint is not changed.
+ */
+void EPDDisplayService::render(const EPDDisplayList& list, EPDPaint& paint) {
+  int line_bytes = paint.getWidth() / 8;
+  int y = paint.getBandY();
+  int rows = paint.getBandHeight();
+  int half = rows / 2;
+  EPDPaint upper(paint.getImage(), paint.getWidth(), paint.getHeight());
+  EPDPaint lower(paint.getImage() + half * line_bytes, paint.getWidth(), paint.getHeight());
+  unsigned long start = serviceMicros();
+  unsigned long work;
+  bool split;
+
+  upper.setRotate(paint.getRotate());
+  lower.setRotate(paint.getRotate());
+  upper.setGlyphCache(paint.getGlyphCache());
+  lower.setGlyphCache(glyphCache);
+  lock();
+  split = running && half > 0 && (jobs | active) == 0;
+  if (split) {
+    renderList = &list;
+    renderPaint = &lower;
+  }
+  unlock();
+  if (split) {
+    upper.setBand(y, half);
+    lower.setBand(y + half, rows - half);
+    post(SERVICE_RENDER);
+  } else {
+    upper.setBand(y, rows);
+  }
+  list.render(upper);
+  work = serviceMicros() - start;
+  if (split) {
+    waitJobs(SERVICE_RENDER);
+    work += renderUs;
+  }
+  lock();
+  stats.renders++;
+  if (split) {
+    stats.splitRenders++;
+  }
+  stats.renderUs = serviceMicros() - start;
+  stats.workUs = work;
+  stats.scaling = stats.renderUs > 0 ? work * 100 / stats.renderUs : 100;
+  unlock();
+}
+
+/**
+ *  @brief: the glyph cache for the rows render() gives to the service
+ *          task (see EPDPaint::setGlyphCache()). a cache is not shared
+ *          between tasks, so this is not the one of the paint drawn.
+ *          NULL draws rotated text without a cache.
+ */
+void EPDDisplayService::setGlyphCache(EPDGlyphCache* cache) {
+  lock();
+  glyphCache = cache;
+  unlock();
+}
+
+/**
+ *  @brief: a copy of the counters, see EPDServiceStats
+ */
+void EPDDisplayService::getStats(EPDServiceStats* stats) {
+  lock();
+  memcpy(stats, &this->stats, sizeof(EPDServiceStats));
+  unlock();
+}
+
+/**
+ *  @brief: private functions to guard the state shared with the task
+ */
+void EPDDisplayService::lock(void) {
+#if defined(ESP32)
+  if (mutex != NULL) {
+    xSemaphoreTake(mutex, portMAX_DELAY);
+  }
+#elif defined(EPD_SERVICE_THREAD)
+  mutex.lock();
+#endif
+}
+
+void EPDDisplayService::unlock(void) {
+#if defined(ESP32)
+  if (mutex != NULL) {
+    xSemaphoreGive(mutex);
+  }
+#elif defined(EPD_SERVICE_THREAD)
+  mutex.unlock();
+#endif
+}
+
+/**
+ *  @brief: private function to hand a job to the task
+ */
+void EPDDisplayService::post(unsigned char job) {
+  lock();
+  jobs |= job;
+  unlock();
+#if defined(ESP32)
+  xTaskNotifyGive(task);
+#elif defined(EPD_SERVICE_THREAD)
+  condition.notify_all();
+#endif
+}
+
+/**
+ *  @brief: private function of the task, wait for the next job
+ */
+unsigned char EPDDisplayService::takeJob(void) {
+  unsigned char job;
+#if defined(ESP32)
+  for (;;) {
+    lock();
+    if (jobs != 0) {
+      break;
+    }
+    unlock();
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  }
+#elif defined(EPD_SERVICE_THREAD)
+  std::unique_lock<std::mutex> guard(mutex);
+  condition.wait(guard, [this] { return jobs != 0; });
+  guard.release();
+#else
+  return SERVICE_STOP;
+#endif
+  job = jobs & SERVICE_RENDER ? SERVICE_RENDER : jobs & SERVICE_FRAME ? SERVICE_FRAME : SERVICE_STOP;
+  jobs &= ~job;
+  active = job;
+  unlock();
+  return job;
+}
+
+/**
+ *  @brief: private function of the task, the job taken is done
+ */
+void EPDDisplayService::finishJob(void) {
+  lock();
+  active = 0;
+  unlock();
+#if defined(ESP32)
+  xSemaphoreGive(done);
+#elif defined(EPD_SERVICE_THREAD)
+  condition.notify_all();
+#endif
+}
+
+/**
+ *  @brief: private function, wait until none of the jobs of mask is
+ *          waiting or being done
+ */
+void EPDDisplayService::waitJobs(unsigned char mask) {
+#if defined(ESP32)
+  /* finishJob() gives done after every job, a job finished between the
+     check and the take leaves it given */
+  for (;;) {
+    bool waiting;
+    lock();
+    waiting = ((jobs | active) & mask) != 0;
+    unlock();
+    if (!waiting) {
+      break;
+    }
+    xSemaphoreTake(done, portMAX_DELAY);
+  }
+#elif defined(EPD_SERVICE_THREAD)
+  std::unique_lock<std::mutex> guard(mutex);
+  condition.wait(guard, [this, mask] { return ((jobs | active) & mask) == 0; });
+#endif
+}
+
+/**
+ *  @brief: private function to send a frame and refresh the display
+ */
+void EPDDisplayService::showFrame(const unsigned char* frame) {
+  /* the clock of the transport, which Linux has too */
+  unsigned long start = epd.getTransport().nowMs();
+  epd.setFrameMemory(frame, 0, 0, epd.width, epd.height);
+  epd.displayFrame();
+  lock();
+  stats.frames++;
+  stats.frameMs = epd.getTransport().nowMs() - start;
+  unlock();
+}
+
+/**
+ *  @brief: private function, the body of the service task
+ */
+void EPDDisplayService::run(void) {
+  unsigned char job;
+  unsigned long start;
+
+  do {
+    job = takeJob();
+    if (job == SERVICE_RENDER) {
+      start = serviceMicros();
+      renderList->render(*renderPaint);
+      renderUs = serviceMicros() - start;
+    } else if (job == SERVICE_FRAME) {
+      showFrame(frame);
+    }
+    finishJob();
+  } while (job != SERVICE_STOP);
+}
+
+void EPDDisplayService::taskBody(void* param) {
+  ((EPDDisplayService*) param)->run();
+#if defined(ESP32)
+  vTaskDelete(NULL);
+#endif
+}
+
+/* END OF FILE */
@@ -0,0 +1,113 @@
+/**
+ *  @filename   :   EPDDisplayService.h
+ *  @brief      :   Header file for EPDDisplayService.cpp
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef EPDDISPLAYSERVICE_H
+#define EPDDISPLAYSERVICE_H
+
+#include "EPD1in54.h"
+
+// The service task is a std::thread in the host build and on Linux boards
+#if defined(EPD_HOST) || (defined(__linux__) && !defined(ARDUINO))
+#define EPD_SERVICE_THREAD
+#endif
+
+#if defined(EPD_SERVICE_THREAD)
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#endif
+
+// Display service task on ESP32, see EPDDisplayService::begin()
+#define EPD_SERVICE_STACK_SIZE  4096
+#define EPD_SERVICE_PRIORITY    2
+#define EPD_SERVICE_CORE        0
+
+/* counters of EPDDisplayService::getStats() */
+struct EPDServiceStats {
+  unsigned long frames;           // frames shown
+  unsigned long frameMs;          // upload and refresh of the last frame
+  unsigned long renders;          // calls of render()
+  unsigned long splitRenders;     // renders shared with the service task
+  unsigned long renderUs;         // time render() took the last time
+  unsigned long workUs;           // time spent drawing by both tasks the last time
+  unsigned int  scaling;          // workUs / renderUs in percent, 200 at best
+};
+
+/**
+ *  a task that owns an EPD1in54 and shows the frames submitted to it, so
+ *  the caller can draw the next frame meanwhile. on ESP32 the task is
+ *  pinned to EPD_SERVICE_CORE, away from the loop() task, and it draws
+ *  half of a frame while it has no frame to show, see render().
+ *  the host build and Linux boards use a std::thread (link with
+ *  -pthread), elsewhere there is no task and everything runs on the
+ *  caller.
+ *  after begin() the module must only be used through the service.
+ */
+class EPDDisplayService {
+ public:
+  EPDDisplayService(EPD1in54& epd);
+  ~EPDDisplayService();
+  int  begin(void);
+  void end(void);
+  bool submit(const unsigned char* frame);
+  bool isIdle(void);
+  void waitIdle(void);
+  void render(const EPDDisplayList& list, EPDPaint& paint);
+  void setGlyphCache(EPDGlyphCache* cache);
+  void getStats(EPDServiceStats* stats);
+
+ private:
+  EPD1in54& epd;
+  bool running;
+  volatile unsigned char jobs;
+  volatile unsigned char active;
+  const unsigned char* frame;
+  const EPDDisplayList* renderList;
+  EPDPaint* renderPaint;
+  EPDGlyphCache* glyphCache;
+  volatile unsigned long renderUs;
+  EPDServiceStats stats;
+#if defined(ESP32)
+  TaskHandle_t task;
+  SemaphoreHandle_t mutex;
+  SemaphoreHandle_t done;
+#elif defined(EPD_SERVICE_THREAD)
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable condition;
+#endif
+
+  void lock(void);
+  void unlock(void);
+  void post(unsigned char job);
+  unsigned char takeJob(void);
+  void finishJob(void);
+  void waitJobs(unsigned char mask);
+  void showFrame(const unsigned char* frame);
+  void run(void);
+  static void taskBody(void* param);
+};
+
+#endif
+
+/* END OF FILE */
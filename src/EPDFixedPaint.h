@@ -0,0 +1,272 @@
+/**
+ *  @filename   :   EPDFixedPaint.h
+ *  @brief      :   EPDPaint with the rotation fixed when compiling
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef EPDFIXEDPAINT_H
+#define EPDFIXEDPAINT_H
+
+#include <string.h>
+#include "EPDPaint.h"
+#include "EPDShapes.h"
+
+/**
+ *  EPDPaint with the rotation (ROTATE_0 ... ROTATE_270) and the color
+ *  inverse fixed when compiling, e.g. EPDFixedPaint<ROTATE_270>, for
+ *  code that never changes them. a pixel is mapped to the image without
+ *  any branch on the rotation, lines and rectangles are filled line by
+ *  line of the image whatever the rotation, and characters are merged
+ *  into the image a line of the glyph at a time. the shapes are drawn by
+ *  the same code as EPDPaint, see EPDShapes.
+ *  it draws the same pixels as an EPDPaint set to the same rotation,
+ *  but keeps no band and no damage.
+ */
+template <int ROTATE, int INVERT = IF_INVERT_COLOR>
+class EPDFixedPaint {
+ public:
+  EPDFixedPaint(unsigned char* image, int width, int height) {
+    this->image = image;
+    /* 1 byte = 8 pixels, so the width should be the multiple of 8 */
+    this->width = width % 8 ? width + 8 - (width % 8) : width;
+    this->height = height;
+    this->stride = this->width / 8;
+  }
+
+  unsigned char* getImage(void) {
+    return this->image;
+  }
+
+  int getWidth(void) {
+    return this->width;
+  }
+
+  int getHeight(void) {
+    return this->height;
+  }
+
+  int getRotate(void) {
+    return ROTATE;
+  }
+
+  void clear(int colored) {
+    memset(this->image, colorBits(colored), this->stride * this->height);
+  }
+
+  /**
+   *  @brief: this draws a pixel by absolute coordinates
+   */
+  void drawAbsolutePixel(int x, int y, int colored) {
+    if ((unsigned int) x >= (unsigned int) this->width || (unsigned int) y >= (unsigned int) this->height) {
+      return;
+    }
+    setPixel(x, y, colored);
+  }
+
+  /**
+   *  @brief: this draws a pixel by the coordinates. the ones EPDPaint
+   *          maps outside of the image (x or y 0 in some rotations) are
+   *          dropped by the bounds check already.
+   */
+  void drawPixel(int x, int y, int colored) {
+    if (
+        (unsigned int) (x - minX()) >= (unsigned int) (limitX() - minX()) ||
+        (unsigned int) (y - minY()) >= (unsigned int) (limitY() - minY())
+        ) {
+      return;
+    }
+    setPixel(absoluteX(x, y), absoluteY(x, y), colored);
+  }
+
+  /**
+   *  @brief: see EPDPaint::drawCharAt(). a character inside the image is
+   *          merged a line of the glyph at a time: a line of the image
+   *          without rotation or upside down, a column of it when turned.
+   */
+  void drawCharAt(int x, int y, char ascii_char, sFONT* font, int colored) {
+    int glyph_width = font->Width;
+    int glyph_height = font->Height;
+    int line_bytes = glyph_width / 8 + (glyph_width % 8 ? 1 : 0);
+    const unsigned char* glyph = &font->table[(ascii_char - ' ') * glyph_height * line_bytes];
+    uint32_t columns = 0xFFFFFFFFUL << (32 - glyph_width);
+    bool set = INVERT ? colored : !colored;
+
+    if (
+        glyph_width > 24 ||
+        x < minX() || x + glyph_width > limitX() ||
+        y < minY() || y + glyph_height > limitY()
+        ) {
+      EPDShapes::drawCharAt(*this, x, y, ascii_char, font, colored);
+      return;
+    }
+    for (int j = 0; j < glyph_height; j++) {
+      uint32_t bits = EPDShapes::glyphLine(glyph, line_bytes, j) & columns;
+      if (ROTATE == ROTATE_0) {
+        EPDShapes::mergeLine(&this->image[(y + j) * this->stride], x, bits, set);
+      } else if (ROTATE == ROTATE_180) {
+        /* right to left: pixel i lands at width - x - i */
+        EPDShapes::mergeLine(
+                             &this->image[(this->height - y - j) * this->stride],
+                             this->width - x - glyph_width + 1,
+                             EPDShapes::reverseBits(bits) << (32 - glyph_width),
+                             set
+                             );
+      } else {
+        int ax = absoluteX(x, y + j);
+        EPDShapes::mergeColumn(
+                               &this->image[absoluteY(x, y + j) * this->stride + ax / 8],
+                               ROTATE == ROTATE_90 ? this->stride : -this->stride,
+                               0x80 >> (ax % 8),
+                               bits,
+                               0,
+                               glyph_width - 1,
+                               set
+                               );
+      }
+    }
+  }
+
+  void drawStringAt(int x, int y, const char* text, sFONT* font, int colored) {
+    EPDShapes::drawStringAt(*this, x, y, text, font, colored);
+  }
+
+  void drawLine(int x0, int y0, int x1, int y1, int colored) {
+    EPDShapes::drawLine(*this, x0, y0, x1, y1, colored);
+  }
+
+  void drawHorizontalLine(int x, int y, int line_width, int colored) {
+    if (line_width > 0) {
+      fillRegion(x, y, x + line_width - 1, y, colored);
+    }
+  }
+
+  void drawVerticalLine(int x, int y, int line_height, int colored) {
+    if (line_height > 0) {
+      fillRegion(x, y, x, y + line_height - 1, colored);
+    }
+  }
+
+  void drawRectangle(int x0, int y0, int x1, int y1, int colored) {
+    EPDShapes::drawRectangle(*this, x0, y0, x1, y1, colored);
+  }
+
+  void drawFilledRectangle(int x0, int y0, int x1, int y1, int colored) {
+    fillRegion(x0, y0, x1, y1, colored);
+  }
+
+  void drawCircle(int x, int y, int radius, int colored) {
+    EPDShapes::drawCircle(*this, x, y, radius, colored, false);
+  }
+
+  void drawFilledCircle(int x, int y, int radius, int colored) {
+    EPDShapes::drawCircle(*this, x, y, radius, colored, true);
+  }
+
+  /**
+   *  @brief: see EPDPaint::fillRegion()
+   */
+  void fillRegion(int x0, int y0, int x1, int y1, int colored) {
+    int min_x = x1 > x0 ? x0 : x1;
+    int max_x = x1 > x0 ? x1 : x0;
+    int min_y = y1 > y0 ? y0 : y1;
+    int max_y = y1 > y0 ? y1 : y0;
+    int ax0, ay0, ax1, ay1;
+
+    min_x = min_x < minX() ? minX() : min_x;
+    min_y = min_y < minY() ? minY() : min_y;
+    max_x = max_x >= limitX() ? limitX() - 1 : max_x;
+    max_y = max_y >= limitY() ? limitY() - 1 : max_y;
+    if (min_x > max_x || min_y > max_y) {
+      return;
+    }
+    /* two opposite corners give the rectangle in the image */
+    ax0 = absoluteX(min_x, min_y);
+    ay0 = absoluteY(min_x, min_y);
+    ax1 = absoluteX(max_x, max_y);
+    ay1 = absoluteY(max_x, max_y);
+    fillAbsolute(
+                 ax0 < ax1 ? ax0 : ax1,
+                 ay0 < ay1 ? ay0 : ay1,
+                 ax0 < ax1 ? ax1 : ax0,
+                 ay0 < ay1 ? ay1 : ay0,
+                 colorBits(colored)
+                 );
+  }
+
+ private:
+  unsigned char* image;
+  int width;
+  int height;
+  int stride;
+
+  /* the area drawPixel() takes, for the rotation */
+  static int minX(void) {
+    return ROTATE == ROTATE_180 || ROTATE == ROTATE_270 ? 1 : 0;
+  }
+
+  static int minY(void) {
+    return ROTATE == ROTATE_90 || ROTATE == ROTATE_180 ? 1 : 0;
+  }
+
+  int limitX(void) {
+    return ROTATE == ROTATE_90 || ROTATE == ROTATE_270 ? this->height : this->width;
+  }
+
+  int limitY(void) {
+    return ROTATE == ROTATE_90 || ROTATE == ROTATE_270 ? this->width : this->height;
+  }
+
+  /* the mapping of EPDPaint::drawPixel() */
+  int absoluteX(int x, int y) {
+    return ROTATE == ROTATE_90 ? this->width - y :
+           ROTATE == ROTATE_180 ? this->width - x :
+           ROTATE == ROTATE_270 ? y : x;
+  }
+
+  int absoluteY(int x, int y) {
+    return ROTATE == ROTATE_90 ? x :
+           ROTATE == ROTATE_180 ? this->height - y :
+           ROTATE == ROTATE_270 ? this->height - x : y;
+  }
+
+  static unsigned char colorBits(int colored) {
+    return (INVERT ? colored : !colored) ? 0xFF : 0x00;
+  }
+
+  void setPixel(int x, int y, int colored) {
+    unsigned char* p = &this->image[y * this->stride + x / 8];
+    if (INVERT ? colored : !colored) {
+      *p |= 0x80 >> (x % 8);
+    } else {
+      *p &= ~(0x80 >> (x % 8));
+    }
+  }
+
+  /* fill a rectangle inside the image line by line */
+  void fillAbsolute(int x0, int y0, int x1, int y1, unsigned char bits) {
+    for (int y = y0; y <= y1; y++) {
+      EPDShapes::fillSpan(&this->image[y * this->stride], x0, x1, bits);
+    }
+  }
+};
+
+#endif
+
+/* END OF FILE */
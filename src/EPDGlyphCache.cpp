@@ -0,0 +1,240 @@
+/**
+ *  @filename   :   EPDGlyphCache.cpp
+ *  @brief      :   Keeps the glyphs of rotated text turned in RAM
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#if defined(__AVR__) || defined(ARDUINO_ARCH_SAMD)
+#include <avr/pgmspace.h>
+#elif defined(ESP8266) || defined(ESP32) || defined(EPD_HOST)
+#include <pgmspace.h>
+#endif
+#include <string.h>
+#include "EPDGlyphCache.h"
+
+// No slot, the end of a chain of the index or of the order of use
+#define SLOT_NONE   0xFF
+
+/**
+ *  a slot of the cache. the slots come first in the buffer, then a byte
+ *  per slot with the first slot of each hash bucket, then the lines of the
+ *  turned glyphs: one per column of the glyph, (Height + 7) / 8 bytes
+ *  each, the first pixel in the most significant bit. glyphs never move,
+ *  the order of use is kept by the newer and older slot numbers.
+ */
+struct EPDGlyphSlot {
+  const sFONT* font;
+  unsigned char character;
+  unsigned char rotate;
+  unsigned char next;
+  unsigned char newer;
+  unsigned char older;
+};
+
+EPDGlyphCache::EPDGlyphCache(unsigned char* buffer, unsigned int size) {
+  this->buffer = buffer;
+  this->size = size;
+  this->slots = NULL;
+  this->buckets = NULL;
+  this->lines = NULL;
+  this->slotBytes = 0;
+  this->count = 0;
+  this->hits = 0;
+  this->misses = 0;
+  clear();
+}
+
+EPDGlyphCache::~EPDGlyphCache() {
+}
+
+/**
+ *  @brief: drop every glyph
+ */
+void EPDGlyphCache::clear(void) {
+  this->used = 0;
+  this->newest = SLOT_NONE;
+  this->oldest = SLOT_NONE;
+  if (this->count > 0) {
+    memset(this->buckets, SLOT_NONE, this->count);
+  }
+}
+
+/**
+ *  @brief: the lines of the glyph of ascii_char turned for rotate, with
+ *          the pixel landing at the lowest coordinates first.
+ *          NULL if rotate is neither ROTATE_90 nor ROTATE_270 or the
+ *          glyph does not fit into the buffer.
+ *          the lines stay valid until the next call.
+ */
+const unsigned char* EPDGlyphCache::get(const sFONT* font, char ascii_char, int rotate) {
+  unsigned char character = ascii_char;
+  int line_bytes = font->Width / 8 + (font->Width % 8 ? 1 : 0);
+  int turned_bytes = font->Height / 8 + (font->Height % 8 ? 1 : 0);
+  unsigned int length = font->Width * turned_bytes;
+  unsigned int index;
+  unsigned char slot;
+  const unsigned char* glyph;
+  unsigned char* lines;
+
+  if (rotate != ROTATE_90 && rotate != ROTATE_270) {
+    return NULL;
+  }
+  if (length > this->slotBytes && !layout(length)) {
+    return NULL;
+  }
+  index = bucket(font, character, rotate);
+  for (slot = this->buckets[index]; slot != SLOT_NONE; slot = this->slots[slot].next) {
+    if (this->slots[slot].font == font && this->slots[slot].character == character && this->slots[slot].rotate == rotate) {
+      if (slot != this->newest) {
+        unlink(slot);
+        link(slot);
+      }
+      this->hits++;
+      return &this->lines[slot * this->slotBytes];
+    }
+  }
+  this->misses++;
+  slot = this->used < this->count ? this->used++ : evict();
+  this->slots[slot].font = font;
+  this->slots[slot].character = character;
+  this->slots[slot].rotate = rotate;
+  this->slots[slot].next = this->buckets[index];
+  this->buckets[index] = slot;
+  link(slot);
+  lines = &this->lines[slot * this->slotBytes];
+
+  /* pixel (i, j) of the glyph goes to line i, bit height - 1 - j when
+   * turned by 90 degrees, to line width - 1 - i, bit j by 270 degrees */
+  memset(lines, 0, length);
+  glyph = &font->table[(ascii_char - ' ') * font->Height * line_bytes];
+  for (int j = 0; j < font->Height; j++) {
+    for (int i = 0; i < font->Width; i++) {
+      if (pgm_read_byte(&glyph[j * line_bytes + i / 8]) & (0x80 >> (i % 8))) {
+        int line = rotate == ROTATE_90 ? i : font->Width - 1 - i;
+        int bit = rotate == ROTATE_90 ? font->Height - 1 - j : j;
+        lines[line * turned_bytes + bit / 8] |= 0x80 >> (bit % 8);
+      }
+    }
+  }
+  return lines;
+}
+
+/**
+ *  @brief: the calls of get() that found the glyph in the cache
+ */
+unsigned long EPDGlyphCache::getHits(void) const {
+  return this->hits;
+}
+
+/**
+ *  @brief: the calls of get() that turned the glyph
+ */
+unsigned long EPDGlyphCache::getMisses(void) const {
+  return this->misses;
+}
+
+/**
+ *  @brief: private function to cut the buffer into slots of slot_bytes,
+ *          dropping every glyph. false, with the cache left as it was,
+ *          if not even one slot fits.
+ */
+bool EPDGlyphCache::layout(unsigned int slot_bytes) {
+  /* the slots hold a pointer, start them on a pointer boundary */
+  unsigned int skip = (sizeof(void*) - (unsigned long) this->buffer % sizeof(void*)) % sizeof(void*);
+  unsigned int count;
+
+  if (this->size < skip) {
+    return false;
+  }
+  count = (this->size - skip) / (sizeof(EPDGlyphSlot) + 1 + slot_bytes);
+  if (count == 0) {
+    return false;
+  }
+  if (count > EPDGLYPHCACHE_MAX_SLOTS) {
+    count = EPDGLYPHCACHE_MAX_SLOTS;
+  }
+  this->slots = (EPDGlyphSlot*) &this->buffer[skip];
+  this->buckets = (unsigned char*) &this->slots[count];
+  this->lines = &this->buckets[count];
+  this->slotBytes = slot_bytes;
+  this->count = count;
+  clear();
+  return true;
+}
+
+/**
+ *  @brief: private function, the hash bucket of a glyph
+ */
+unsigned int EPDGlyphCache::bucket(const sFONT* font, unsigned char character, unsigned char rotate) const {
+  unsigned long key = (unsigned long) font / sizeof(void*) * 31 + character * 2 + (rotate == ROTATE_270);
+  return key % this->count;
+}
+
+/**
+ *  @brief: private function to take slot out of the order of use
+ */
+void EPDGlyphCache::unlink(unsigned char slot) {
+  EPDGlyphSlot* entry = &this->slots[slot];
+
+  if (entry->newer != SLOT_NONE) {
+    this->slots[entry->newer].older = entry->older;
+  } else {
+    this->newest = entry->older;
+  }
+  if (entry->older != SLOT_NONE) {
+    this->slots[entry->older].newer = entry->newer;
+  } else {
+    this->oldest = entry->newer;
+  }
+}
+
+/**
+ *  @brief: private function to make slot the glyph used most recently
+ */
+void EPDGlyphCache::link(unsigned char slot) {
+  EPDGlyphSlot* entry = &this->slots[slot];
+
+  entry->newer = SLOT_NONE;
+  entry->older = this->newest;
+  if (this->newest != SLOT_NONE) {
+    this->slots[this->newest].newer = slot;
+  } else {
+    this->oldest = slot;
+  }
+  this->newest = slot;
+}
+
+/**
+ *  @brief: private function to drop the glyph used least recently and
+ *          give its slot
+ */
+unsigned char EPDGlyphCache::evict(void) {
+  unsigned char slot = this->oldest;
+  unsigned char* chain = &this->buckets[bucket(this->slots[slot].font, this->slots[slot].character, this->slots[slot].rotate)];
+
+  unlink(slot);
+  while (*chain != slot) {
+    chain = &this->slots[*chain].next;
+  }
+  *chain = this->slots[slot].next;
+  return slot;
+}
+
+/* END OF FILE */
@@ -0,0 +1,77 @@
+/**
+ *  @filename   :   EPDGlyphCache.h
+ *  @brief      :   Header file for EPDGlyphCache.cpp
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef EPDGLYPHCACHE_H
+#define EPDGLYPHCACHE_H
+
+#include "EPDPaint.h"
+
+/* the most glyphs a cache keeps, whatever the size of its buffer */
+#define EPDGLYPHCACHE_MAX_SLOTS     254
+
+struct EPDGlyphSlot;
+
+/**
+ *  the glyphs of rotated text, turned once and kept in a small buffer, so
+ *  that EPDPaint draws ROTATE_90 and ROTATE_270 text a byte at a time
+ *  (see EPDPaint::setGlyphCache()). the buffer is cut into slots of the
+ *  largest glyph turned so far: a glyph of Font24 takes 51 bytes, one of
+ *  Font12 14 bytes, plus a header of 8 to 17 bytes depending on the
+ *  board. a larger glyph cuts the buffer again, dropping every glyph.
+ *  glyphs are found through a hash of the font, the character and the
+ *  rotation, and when every slot is taken the glyph used least recently
+ *  is dropped.
+ */
+class EPDGlyphCache {
+ public:
+  EPDGlyphCache(unsigned char* buffer, unsigned int size);
+  ~EPDGlyphCache();
+  void clear(void);
+  const unsigned char* get(const sFONT* font, char ascii_char, int rotate);
+  unsigned long getHits(void) const;
+  unsigned long getMisses(void) const;
+
+ private:
+  unsigned char* buffer;
+  unsigned int size;
+  EPDGlyphSlot* slots;
+  unsigned char* buckets;
+  unsigned char* lines;
+  unsigned int slotBytes;
+  unsigned int count;
+  unsigned int used;
+  unsigned char newest;
+  unsigned char oldest;
+  unsigned long hits;
+  unsigned long misses;
+
+  bool layout(unsigned int slot_bytes);
+  unsigned int bucket(const sFONT* font, unsigned char character, unsigned char rotate) const;
+  void unlink(unsigned char slot);
+  void link(unsigned char slot);
+  unsigned char evict(void);
+};
+
+#endif
+
+/* END OF FILE */
@@ -25,35 +25,592 @@
  * THE SOFTWARE.
  */
 
+#include <string.h>
 #include "EPDIF.h"
-#include <SPI.h>
 
-EPDIF::EPDIF(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy) {
+EPDIF::EPDIF(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy, unsigned long spi_clock) {
   resetPin = reset;
   dcPin = dc;
   csPin = cs;
   busyPin = busy;
+  spiClock = spi_clock;
+  refreshTime = 0;
+  refreshing = false;
+  refreshIdleLevel = LOW;
+  refreshStart = 0;
+  yieldCallback = NULL;
+  yieldArg = NULL;
+  shadowCount = 0;
+  shadowNext = 0;
+  asyncData = NULL;
+  asyncLength = 0;
+  asyncCallback = NULL;
+  asyncArg = NULL;
+  asyncBusy = false;
+#if defined(ESP32)
+  asyncTask = NULL;
+  asyncFinished = NULL;
+#endif
 };
 
 EPDIF::~EPDIF() {
+#if defined(ESP32)
+  if (asyncTask != NULL) {
+    waitTransfer();
+    vTaskDelete(asyncTask);
+  }
+  if (asyncFinished != NULL) {
+    vSemaphoreDelete(asyncFinished);
+  }
+#endif
 };
 
 void EPDIF::delayMs(unsigned int delaytime) {
-  delay(delaytime);
+  transport.delayMs(delaytime);
 }
 
 void EPDIF::spiTransfer(unsigned char data) {
-  digitalWrite(csPin, LOW);
-  SPI.transfer(data);
-  digitalWrite(csPin, HIGH);
+  waitTransfer();
+  transport.select();
+  transport.transfer(data);
+  transport.deselect();
 }
 
-int EPDIF::ifInit() {
-  pinMode(csPin, OUTPUT);
-  pinMode(resetPin, OUTPUT);
-  pinMode(dcPin, OUTPUT);
-  pinMode(busyPin, INPUT);
-  SPI.beginTransaction(SPISettings(2000000, MSBFIRST, SPI_MODE0));
-  SPI.begin();
+/**
+ *  @brief: send a block of bytes from RAM while CS is held low.
+ */
+void EPDIF::spiTransferBuffer(const unsigned char* data, unsigned int len) {
+  waitTransfer();
+  transport.select();
+  transport.write(data, len);
+  transport.deselect();
+}
+
+/**
+ *  @brief: same as spiTransferBuffer but reads the data from the flash
+ *          (PROGMEM) with pgm_read_byte.
+ */
+void EPDIF::spiTransferBufferP(const unsigned char* data, unsigned int len) {
+#if defined(ESP32)
+  spiTransferBuffer(data, len);
+#else
+  unsigned char chunk[EPDIF_CHUNK_SIZE];
+  waitTransfer();
+  transport.select();
+  while (len > 0) {
+    unsigned int count = len < EPDIF_CHUNK_SIZE ? len : EPDIF_CHUNK_SIZE;
+    for (unsigned int i = 0; i < count; i++) {
+      chunk[i] = pgm_read_byte(&data[i]);
+    }
+    transport.writeStaged(chunk, count);
+    data += count;
+    len -= count;
+  }
+  transport.deselect();
+#endif
+}
+
+/**
+ *  @brief: send the same byte len times while CS is held low.
+ */
+void EPDIF::spiTransferFill(unsigned char value, unsigned int len) {
+  unsigned char chunk[EPDIF_CHUNK_SIZE];
+  waitTransfer();
+  transport.select();
+  while (len > 0) {
+    unsigned int count = len < EPDIF_CHUNK_SIZE ? len : EPDIF_CHUNK_SIZE;
+    memset(chunk, value, count);
+    transport.writeStaged(chunk, count);
+    len -= count;
+  }
+  transport.deselect();
+}
+
+/**
+ *  @brief: start sending a block of bytes from RAM and return at once.
+ *          on ESP32 a worker task streams the block to the SPI peripheral
+ *          while the caller keeps running. elsewhere the transport may
+ *          send it in the background (the host build simulates a DMA
+ *          transfer, see EPDHost::queueDma()), or it is sent
+ *          synchronously. the callback is called from the worker task
+ *          (or before returning) once the block has been sent.
+ *          the data must stay valid until then.
+ *          every other transfer waits for a pending one to finish first.
+ */
+int EPDIF::spiTransferBufferAsync(
+                                  const unsigned char* data,
+                                  unsigned int len,
+                                  EPDTransferCallback callback,
+                                  void* arg
+                                  ) {
+  waitTransfer();
+#if defined(ESP32)
+  if (asyncFinished == NULL) {
+    asyncFinished = xSemaphoreCreateBinary();
+    if (asyncFinished == NULL) {
+      return -1;
+    }
+  }
+  if (asyncTask == NULL) {
+    if (xTaskCreatePinnedToCore(
+                                asyncWorker,
+                                "EPDIF",
+                                EPDIF_ASYNC_STACK_SIZE,
+                                this,
+                                EPDIF_ASYNC_PRIORITY,
+                                &asyncTask,
+                                EPDIF_ASYNC_CORE
+                                ) != pdPASS) {
+      asyncTask = NULL;
+      return -1;
+    }
+  }
+  asyncData = data;
+  asyncLength = len;
+  asyncCallback = callback;
+  asyncArg = arg;
+  asyncBusy = true;
+  xTaskNotifyGive(asyncTask);
+#else
+  asyncCallback = callback;
+  asyncArg = arg;
+  asyncBusy = true;
+  transport.select();
+  if (transport.writeAsync(data, len, asyncDone, this) != 0) {
+    transport.write(data, len);
+    asyncDone(this);
+  }
+#endif
   return 0;
 }
+
+/**
+ *  @brief: true while an asynchronous transfer is in flight
+ */
+bool EPDIF::isTransferBusy(void) {
+  return asyncBusy;
+}
+
+/**
+ *  @brief: block until the pending asynchronous transfer has finished.
+ *          this returns at once when called from the completion callback.
+ */
+void EPDIF::waitTransfer(void) {
+#if defined(ESP32)
+  if (asyncTask == NULL || xTaskGetCurrentTaskHandle() == asyncTask) {
+    return;
+  }
+  /* the worker gives asyncFinished after every block, a block finished
+     before this wait leaves it given and the loop checks again */
+  while (asyncBusy) {
+    xSemaphoreTake(asyncFinished, portMAX_DELAY);
+  }
+#else
+  while (asyncBusy) {
+    transport.finishAsync();
+  }
+#endif
+}
+
+#if defined(ESP32)
+/**
+ *  @brief: worker task body, sends one queued block per notification
+ *          and wakes up waitTransfer()
+ */
+void EPDIF::asyncWorker(void* param) {
+  EPDIF* epdif = (EPDIF*) param;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    epdif->spiTransferBuffer(epdif->asyncData, epdif->asyncLength);
+    if (epdif->asyncCallback != NULL) {
+      epdif->asyncCallback(epdif->asyncArg);
+    }
+    epdif->asyncBusy = false;
+    xSemaphoreGive(epdif->asyncFinished);
+  }
+}
+#endif
+
+#if !defined(ESP32)
+/**
+ *  @brief: completion of a transfer started by the transport.
+ *          there is no second task here, so the transfer is marked done
+ *          before the callback, which may send further commands.
+ */
+void EPDIF::asyncDone(void* param) {
+  EPDIF* epdif = (EPDIF*) param;
+  epdif->transport.deselect();
+  epdif->asyncBusy = false;
+  if (epdif->asyncCallback != NULL) {
+    epdif->asyncCallback(epdif->asyncArg);
+  }
+}
+#endif
+
+/**
+ *  @brief: set the DC pin, after any pending transfer has gone out
+ */
+void EPDIF::dcWrite(int level) {
+  waitTransfer();
+  transport.writeDc(level);
+}
+
+/**
+ *  @brief: set the RESET pin
+ */
+void EPDIF::resetWrite(int level) {
+  transport.writeReset(level);
+}
+
+/**
+ *  @brief: read the BUSY pin
+ */
+int EPDIF::busyRead(void) {
+  return transport.readBusy();
+}
+
+int EPDIF::ifInit() {
+  return transport.begin(resetPin, dcPin, csPin, busyPin, spiClock);
+}
+
+/**
+ *  @brief: change the SPI clock, takes effect at once
+ */
+void EPDIF::setSpiClock(unsigned long spi_clock) {
+  waitTransfer();
+  spiClock = spi_clock;
+  transport.setClock(spiClock);
+}
+
+unsigned long EPDIF::getSpiClock(void) {
+  return spiClock;
+}
+
+/**
+ *  @brief: the transport object, e.g. to configure it before init()
+ */
+EPD_TRANSPORT& EPDIF::getTransport(void) {
+  return transport;
+}
+
+/**
+ *  @brief: wait until the busyPin reads the level, false on timeout or
+ *          when the pin can not be read. a pending transfer is finished first, as its completion may
+ *          start a refresh. reaching the idle level ends a refresh,
+ *          see refreshStarted().
+ */
+bool EPDIF::waitBusyLevel(int level, unsigned long timeout_ms) {
+  unsigned long start;
+  unsigned long elapsed;
+  unsigned long slice;
+  bool refresh;
+
+  waitTransfer();
+  if (yieldCallback == NULL) {
+    if (!transport.waitBusy(level, timeout_ms)) {
+      return false;
+    }
+  } else {
+    /* wait in slices and let the application run in between */
+    start = transport.nowMs();
+    refresh = refreshing && level == refreshIdleLevel;
+    for (;;) {
+      elapsed = transport.nowMs() - start;
+      slice = EPDIF_YIELD_INTERVAL_MS;
+      if (timeout_ms != EPD_WAIT_FOREVER) {
+        if (elapsed >= timeout_ms) {
+          return false;
+        }
+        if (timeout_ms - elapsed < slice) {
+          slice = timeout_ms - elapsed;
+        }
+      }
+      if (transport.waitBusy(level, slice)) {
+        break;
+      }
+      if (transport.readBusy() < 0) {
+        return false;
+      }
+      if (refresh) {
+        elapsed = transport.nowMs() - refreshStart;
+        yieldCallback(elapsed, elapsed < refreshTime ? refreshTime - elapsed : 0, yieldArg);
+      } else {
+        yieldCallback(transport.nowMs() - start, 0, yieldArg);
+      }
+    }
+  }
+  if (refreshing && level == refreshIdleLevel) {
+    refreshStatus();
+  }
+  return true;
+}
+
+/**
+ *  @brief: true once after a block the transport failed to send, see
+ *          takeWriteError() in EPDTransport.h. a pending transfer is
+ *          finished first.
+ */
+bool EPDIF::transferFailed(void) {
+  waitTransfer();
+  return transport.takeWriteError();
+}
+
+/**
+ *  @brief: replay a command table from the flash (PROGMEM).
+ *          every entry is the command, a byte with the payload length
+ *          and the EPD_SEQ_* flags, the payload and, with EPD_SEQ_DELAY,
+ *          one byte of delay in ms. the payload goes out in one burst.
+ *          entries that set a register to the value it already holds
+ *          are skipped, see shadowUpdate().
+ *          with EPD_SEQ_WAIT the busyPin is waited for to read
+ *          idle_level after the entry (and its delay).
+ */
+void EPDIF::sendSequence(const unsigned char* table, unsigned int len, int idle_level) {
+  unsigned int i = 0;
+  unsigned char flags;
+  unsigned char count;
+
+  while (i + 1 < len) {
+    flags = pgm_read_byte(&table[i + 1]);
+    count = flags & EPD_SEQ_LENGTH;
+    /* an entry that waits or pauses is an action, it is always sent */
+    if (shadowUpdate(pgm_read_byte(&table[i]), &table[i + 2], count, true)
+        || (flags & (EPD_SEQ_DELAY | EPD_SEQ_WAIT))) {
+      dcWrite(LOW);
+      spiTransfer(pgm_read_byte(&table[i]));
+      if (count > 0) {
+        dcWrite(HIGH);
+        spiTransferBufferP(&table[i + 2], count);
+      }
+    }
+    i += 2 + count;
+    if (flags & EPD_SEQ_DELAY) {
+      delayMs(pgm_read_byte(&table[i]));
+      i++;
+    }
+    if (flags & EPD_SEQ_WAIT) {
+      waitBusyLevel(idle_level, EPD_WAIT_FOREVER);
+    }
+  }
+}
+
+/**
+ *  @brief: send a command with its payload from RAM, unless the register
+ *          already holds it. only for registers that keep their value,
+ *          see shadowUpdate().
+ */
+void EPDIF::writeRegister(unsigned char command, const unsigned char* data, unsigned int len) {
+  if (!shadowUpdate(command, data, len, false)) {
+    return;
+  }
+  dcWrite(LOW);
+  spiTransfer(command);
+  if (len > 0) {
+    dcWrite(HIGH);
+    spiTransferBuffer(data, len);
+  }
+}
+
+/**
+ *  @brief: remember the payload last written to a register and tell
+ *          whether it has to be sent. payloads of up to 4 bytes are kept
+ *          as they are, longer ones (e.g. look-up tables) as a hash.
+ *          commands without a payload are actions and always sent.
+ *          the drivers never pass commands whose registers change on
+ *          their own, like the RAM address counters.
+ */
+bool EPDIF::shadowUpdate(unsigned char command, const unsigned char* data, unsigned int len, bool progmem) {
+  unsigned long key;
+  unsigned int i;
+
+  if (len == 0) {
+    return true;
+  }
+  key = shadowKey(data, len, progmem);
+  for (i = 0; i < shadowCount; i++) {
+    if (shadowCommand[i] == command) {
+      break;
+    }
+  }
+  if (i < shadowCount) {
+    if (shadowLength[i] == len && shadowValue[i] == key) {
+      return false;
+    }
+  } else if (shadowCount < EPDIF_SHADOW_SIZE) {
+    i = shadowCount++;
+  } else {
+    /* full, replace the entries in turn */
+    i = shadowNext;
+    shadowNext = (shadowNext + 1) % EPDIF_SHADOW_SIZE;
+  }
+  shadowCommand[i] = command;
+  shadowLength[i] = len;
+  shadowValue[i] = key;
+  return true;
+}
+
+/**
+ *  @brief: private function, the payload itself or its FNV-1a hash
+ */
+unsigned long EPDIF::shadowKey(const unsigned char* data, unsigned int len, bool progmem) {
+  unsigned long key = 0;
+  unsigned char value;
+
+  if (len > 4) {
+    key = 2166136261UL;
+  }
+  for (unsigned int i = 0; i < len; i++) {
+    value = progmem ? pgm_read_byte(&data[i]) : data[i];
+    if (len > 4) {
+      key = (key ^ value) * 16777619UL;
+    } else {
+      key = (key << 8) | value;
+    }
+  }
+  return key;
+}
+
+/**
+ *  @brief: forget the register values sent so far, so the next writes
+ *          of the registers are sent whatever they hold. the drivers
+ *          call this on reset and sleep, call it after changing
+ *          registers with sendCommand()/sendData() directly.
+ */
+void EPDIF::invalidateShadow(void) {
+  shadowCount = 0;
+  shadowNext = 0;
+}
+
+/**
+ *  @brief: have callback called every EPDIF_YIELD_INTERVAL_MS or so while
+ *          the module is busy, e.g. to feed a watchdog or to run other
+ *          tasks. during a refresh it gets the time since the refresh
+ *          started and the expected time left, see getRefreshTime().
+ *          NULL waits without interruption.
+ */
+void EPDIF::setYieldCallback(EPDYieldCallback callback, void* arg) {
+  yieldCallback = callback;
+  yieldArg = arg;
+}
+
+/**
+ *  @brief: the driver has just started a refresh, which ends when the
+ *          busyPin reads idle_level
+ */
+void EPDIF::refreshStarted(int idle_level) {
+  refreshIdleLevel = idle_level;
+  refreshStart = transport.nowMs();
+  refreshing = true;
+}
+
+/**
+ *  @brief: EPD_FRAME_UPLOADING while an asynchronous upload is in flight,
+ *          EPD_FRAME_REFRESHING while the module is busy with a refresh
+ *          and EPD_FRAME_DONE otherwise. the time of a finished refresh
+ *          is kept as the expected time of the next one.
+ */
+int EPDIF::refreshStatus(void) {
+  if (asyncBusy) {
+    return EPD_FRAME_UPLOADING;
+  }
+  if (!refreshing) {
+    return EPD_FRAME_DONE;
+  }
+  if (transport.readBusy() != refreshIdleLevel) {
+    return EPD_FRAME_REFRESHING;
+  }
+  refreshTime = transport.nowMs() - refreshStart;
+  refreshing = false;
+  return EPD_FRAME_DONE;
+}
+
+/**
+ *  @brief: time since the running refresh started, or the time the
+ *          last one took
+ */
+unsigned long EPDIF::getRefreshElapsed(void) {
+  if (refreshing) {
+    return transport.nowMs() - refreshStart;
+  }
+  return refreshTime;
+}
+
+/**
+ *  @brief: the time the last refresh took, the expected time of the next
+ */
+unsigned long EPDIF::getRefreshTime(void) {
+  return refreshTime;
+}
+
+/**
+ *  @brief: progress of the running refresh in percent, estimated from
+ *          the time the last one took. stays at 99 until BUSY is released.
+ */
+unsigned int EPDIF::getRefreshProgress(void) {
+  unsigned long elapsed;
+  if (!refreshing) {
+    return asyncBusy ? 0 : 100;
+  }
+  elapsed = transport.nowMs() - refreshStart;
+  if (elapsed >= refreshTime) {
+    return 99;
+  }
+  return elapsed * 100 / refreshTime;
+}
+
+/**
+ *  @brief: step the SPI clock up from the current one and keep the
+ *          highest clock at which check passes EPDIF_PROBE_ROUNDS times
+ *          in a row. the clock is doubled at every step and max_clock
+ *          itself is tried last. the starting clock is kept even if
+ *          check fails there.
+ */
+unsigned long EPDIF::probeClock(unsigned long max_clock, EPDClockCheck check, void* arg) {
+  unsigned long good_clock = spiClock;
+  unsigned long clock = spiClock;
+
+  while (clock < max_clock) {
+    clock = clock * 2 <= max_clock ? clock * 2 : max_clock;
+    setSpiClock(clock);
+    for (int round = 0; round < EPDIF_PROBE_ROUNDS; round++) {
+      if (!check(arg)) {
+        setSpiClock(good_clock);
+        return good_clock;
+      }
+    }
+    good_clock = clock;
+  }
+  return good_clock;
+}
+
+/**
+ *  @brief: private fill functions of rowSourceRam() and rowSourceProgmem()
+ */
+static void fillRowsRam(unsigned char* rows, int y, int count, int row_bytes, void* arg) {
+  memcpy(rows, (const unsigned char*) arg + (long) y * row_bytes, (long) count * row_bytes);
+}
+
+static void fillRowsProgmem(unsigned char* rows, int y, int count, int row_bytes, void* arg) {
+  const unsigned char* image = (const unsigned char*) arg + (long) y * row_bytes;
+  for (long i = 0; i < (long) count * row_bytes; i++) {
+    rows[i] = pgm_read_byte(&image[i]);
+  }
+}
+
+/**
+ *  @brief: a row source reading an image buffer in RAM or in the flash
+ *          (PROGMEM), so one upload function takes both
+ */
+EPDRowSource rowSourceRam(const unsigned char* image) {
+  EPDRowSource source;
+  source.fill = fillRowsRam;
+  source.arg = (void*) image;
+  return source;
+}
+
+EPDRowSource rowSourceProgmem(const unsigned char* image) {
+  EPDRowSource source;
+  source.fill = fillRowsProgmem;
+  source.arg = (void*) image;
+  return source;
+}
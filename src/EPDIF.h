@@ -29,21 +29,136 @@
 #define EPDIF_H
 
 #include <Arduino.h>
+#include "EPDTransport.h"
+
+// Transport policy, see EPDTransport.h. e.g. -DEPD_TRANSPORT="EPDTransportSoftSPI<23, 18>"
+#ifndef EPD_TRANSPORT
+#define EPD_TRANSPORT   EPDTransportSPI
+#endif
+
+// SPI clock used unless another one is given to the constructor
+#define EPDIF_SPI_CLOCK         2000000
+
+// Clock probing, see EPDIF::probeClock()
+#define EPDIF_PROBE_ROUNDS      3
+#define EPDIF_PROBE_TIMEOUT_MS  1000
+
+// Worker task used for asynchronous uploads on ESP32
+#define EPDIF_ASYNC_STACK_SIZE  2048
+#define EPDIF_ASYNC_PRIORITY    2
+#define EPDIF_ASYNC_CORE        0
+
+// Refresh state, see EPDIF::refreshStatus()
+#define EPD_FRAME_DONE          0
+#define EPD_FRAME_UPLOADING     1
+#define EPD_FRAME_REFRESHING    2
+
+// Command tables, see EPDIF::sendSequence()
+#define EPD_SEQ_DELAY           0x80    // a delay in ms follows the payload
+#define EPD_SEQ_WAIT            0x40    // wait for the module to be idle
+#define EPD_SEQ_LENGTH          0x3F    // payload length
+
+// Registers remembered by the shadow cache, see EPDIF::shadowUpdate()
+#ifndef EPDIF_SHADOW_SIZE
+#define EPDIF_SHADOW_SIZE       16
+#endif
+
+// Longest time between two calls of the yield callback while BUSY is waited for
+#define EPDIF_YIELD_INTERVAL_MS 10
+
+/* called while the module is busy, remaining_ms is 0 when it can not be estimated */
+typedef void (*EPDYieldCallback)(unsigned long elapsed_ms, unsigned long remaining_ms, void* arg);
+
+/* sends a command that gets a visible answer from the module, see EPDIF::probeClock() */
+typedef bool (*EPDClockCheck)(void* arg);
+
+/* puts count lines of row_bytes bytes into rows, the first one being line y of the image */
+typedef void (*EPDRowFill)(unsigned char* rows, int y, int count, int row_bytes, void* arg);
+
+/* an image made a few lines at a time instead of kept in a buffer */
+struct EPDRowSource {
+  EPDRowFill fill;
+  void* arg;
+};
+
+EPDRowSource rowSourceRam(const unsigned char* image);
+EPDRowSource rowSourceProgmem(const unsigned char* image);
 
 class EPDIF {
  public:
-  EPDIF(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy);
+  EPDIF(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy, unsigned long spi_clock = EPDIF_SPI_CLOCK);
   ~EPDIF(void);
 
   int  ifInit();
-  static void delayMs(unsigned int delaytime);
+  void setSpiClock(unsigned long spi_clock);
+  unsigned long getSpiClock(void);
+  EPD_TRANSPORT& getTransport(void);
+  void delayMs(unsigned int delaytime);
   void spiTransfer(unsigned char data);
+  void spiTransferBuffer(const unsigned char* data, unsigned int len);
+  void spiTransferBufferP(const unsigned char* data, unsigned int len);
+  void spiTransferFill(unsigned char value, unsigned int len);
+  int  spiTransferBufferAsync(
+                              const unsigned char* data,
+                              unsigned int len,
+                              EPDTransferCallback callback,
+                              void* arg
+                              );
+  bool isTransferBusy(void);
+  void waitTransfer(void);
+  unsigned long getRefreshElapsed(void);
+  unsigned long getRefreshTime(void);
+  unsigned int  getRefreshProgress(void);
+  void setYieldCallback(EPDYieldCallback callback, void* arg);
+  void invalidateShadow(void);
 
  protected:
   unsigned int resetPin;
   unsigned int dcPin;
   unsigned int csPin;
   unsigned int busyPin;
+  unsigned long spiClock;
+  unsigned long refreshTime;
+
+  void dcWrite(int level);
+  void resetWrite(int level);
+  int  busyRead(void);
+  bool waitBusyLevel(int level, unsigned long timeout_ms);
+  bool transferFailed(void);
+  unsigned long probeClock(unsigned long max_clock, EPDClockCheck check, void* arg);
+  void sendSequence(const unsigned char* table, unsigned int len, int idle_level);
+  void writeRegister(unsigned char command, const unsigned char* data, unsigned int len);
+  bool shadowUpdate(unsigned char command, const unsigned char* data, unsigned int len, bool progmem);
+  void refreshStarted(int idle_level);
+  int  refreshStatus(void);
+
+ private:
+  EPD_TRANSPORT transport;
+  const unsigned char* asyncData;
+  unsigned int asyncLength;
+  EPDTransferCallback asyncCallback;
+  void* asyncArg;
+  volatile bool asyncBusy;
+  volatile bool refreshing;
+  int refreshIdleLevel;
+  unsigned long refreshStart;
+  EPDYieldCallback yieldCallback;
+  unsigned char shadowCommand[EPDIF_SHADOW_SIZE];
+  unsigned char shadowLength[EPDIF_SHADOW_SIZE];
+  unsigned long shadowValue[EPDIF_SHADOW_SIZE];
+  unsigned int shadowCount;
+  unsigned int shadowNext;
+  void* yieldArg;
+
+  static unsigned long shadowKey(const unsigned char* data, unsigned int len, bool progmem);
+#if defined(ESP32)
+  TaskHandle_t asyncTask;
+  SemaphoreHandle_t asyncFinished;
+
+  static void asyncWorker(void* param);
+#else
+  static void asyncDone(void* param);
+#endif
 };
 
 #endif
@@ -26,10 +26,13 @@
 
 #if defined(__AVR__) || defined(ARDUINO_ARCH_SAMD)
 #include <avr/pgmspace.h>
-#elif defined(ESP8266) || defined(ESP32)
+#elif defined(ESP8266) || defined(ESP32) || defined(EPD_HOST)
 #include <pgmspace.h>
 #endif
+#include <string.h>
 #include "EPDPaint.h"
+#include "EPDGlyphCache.h"
+#include "EPDShapes.h"
 
 EPDPaint::EPDPaint(unsigned char* image, int width, int height) {
   this->rotate = ROTATE_0;
@@ -37,20 +40,62 @@ EPDPaint::EPDPaint(unsigned char* image, int width, int height) {
   /* 1 byte = 8 pixels, so the width should be the multiple of 8 */
   this->width = width % 8 ? width + 8 - (width % 8) : width;
   this->height = height;
+  this->bandY = 0;
+  this->bandHeight = height;
+  this->glyphCache = NULL;
+  clearDamage();
 }
 
 EPDPaint::~EPDPaint() {
 }
 
 /**
- *  @brief: clear the image
+ *  @brief: clear the image (the rows of the band, see setBand())
  */
 void EPDPaint::clear(int colored) {
-  for (int x = 0; x < this->width; x++) {
-    for (int y = 0; y < this->height; y++) {
-      drawAbsolutePixel(x, y, colored);
-    }
+  fillAbsolute(0, 0, this->width - 1, this->height - 1, colorBits(colored), NULL);
+}
+
+/**
+ *  @brief: this fills a rectangle a byte at a time, with the same pixels
+ *          as drawing every one of them with drawPixel()
+ */
+void EPDPaint::fillRegion(int x0, int y0, int x1, int y1, int colored) {
+  int min_x = x1 > x0 ? x0 : x1;
+  int max_x = x1 > x0 ? x1 : x0;
+  int min_y = y1 > y0 ? y0 : y1;
+  int max_y = y1 > y0 ? y1 : y0;
+  int max_x_pos = this->rotate == ROTATE_90 || this->rotate == ROTATE_270 ? this->height - 1 : this->width - 1;
+  int max_y_pos = this->rotate == ROTATE_90 || this->rotate == ROTATE_270 ? this->width - 1 : this->height - 1;
+  unsigned char bits = colorBits(colored);
+
+  /* the area drawPixel() takes */
+  min_x = min_x < 0 ? 0 : min_x;
+  min_y = min_y < 0 ? 0 : min_y;
+  max_x = max_x > max_x_pos ? max_x_pos : max_x;
+  max_y = max_y > max_y_pos ? max_y_pos : max_y;
+  if (min_x > max_x || min_y > max_y) {
+    return;
   }
+  if (this->rotate == ROTATE_90) {
+    fillAbsolute(this->width - max_y, min_x, this->width - min_y, max_x, bits, NULL);
+  } else if (this->rotate == ROTATE_180) {
+    fillAbsolute(this->width - max_x, this->height - max_y, this->width - min_x, this->height - min_y, bits, NULL);
+  } else if (this->rotate == ROTATE_270) {
+    fillAbsolute(min_y, this->height - max_x, max_y, this->height - min_x, bits, NULL);
+  } else {
+    fillAbsolute(min_x, min_y, max_x, max_y, bits, NULL);
+  }
+}
+
+/**
+ *  @brief: fill the image (the rows of the band) with an 8x8 pattern,
+ *          e.g. a dither. pattern[y % 8] is the row of absolute line y,
+ *          a set bit is a colored pixel and the most significant bit is
+ *          the one of the columns that are multiples of 8.
+ */
+void EPDPaint::fillPattern(const unsigned char* pattern) {
+  fillAbsolute(0, 0, this->width - 1, this->height - 1, 0, pattern);
 }
 
 /**
@@ -61,6 +106,11 @@ void EPDPaint::drawAbsolutePixel(int x, int y, int colored) {
   if (x < 0 || x >= this->width || y < 0 || y >= this->height) {
     return;
   }
+  if (y < this->bandY || y >= this->bandY + this->bandHeight) {
+    return;
+  }
+  damage(x, y, x, y);
+  y -= this->bandY;
   if (IF_INVERT_COLOR) {
     if (colored) {
       image[(x + y * this->width) / 8] |= 0x80 >> (x % 8);
@@ -76,6 +126,203 @@ void EPDPaint::drawAbsolutePixel(int x, int y, int colored) {
   }
 }
 
+/**
+ *  @brief: private function, the byte of 8 pixels of a color
+ */
+unsigned char EPDPaint::colorBits(int colored) {
+  if (IF_INVERT_COLOR) {
+    return colored ? 0xFF : 0x00;
+  }
+  return colored ? 0x00 : 0xFF;
+}
+
+/**
+ *  @brief: private function to fill a rectangle of absolute coordinates,
+ *          cut to the image and the band, with bits or with a pattern
+ *          (see fillPattern()) if it is not NULL
+ */
+void EPDPaint::fillAbsolute(int x0, int y0, int x1, int y1, unsigned char bits, const unsigned char* pattern) {
+  int y_start = this->bandY > 0 ? this->bandY : 0;
+  int y_end = this->bandY + this->bandHeight < this->height ? this->bandY + this->bandHeight - 1 : this->height - 1;
+
+  x0 = x0 < 0 ? 0 : x0;
+  x1 = x1 >= this->width ? this->width - 1 : x1;
+  y0 = y0 < y_start ? y_start : y0;
+  y1 = y1 > y_end ? y_end : y1;
+  if (x0 > x1 || y0 > y1) {
+    return;
+  }
+  damage(x0, y0, x1, y1);
+  if (pattern == NULL && x0 / 8 == x1 / 8) {
+    /* a column inside one byte, e.g. a vertical line: the same mask on every line */
+    unsigned char mask = (0xFF >> (x0 % 8)) & (0xFF << (7 - x1 % 8));
+    unsigned char* p = &this->image[(y0 - this->bandY) * (this->width / 8) + x0 / 8];
+    for (int y = y0; y <= y1; y++) {
+      *p = (*p & ~mask) | (bits & mask);
+      p += this->width / 8;
+    }
+    return;
+  }
+  for (int y = y0; y <= y1; y++) {
+    if (pattern != NULL) {
+      bits = IF_INVERT_COLOR ? pattern[y % 8] : ~pattern[y % 8];
+    }
+    fillSpan(x0, x1, y, bits);
+  }
+}
+
+/**
+ *  @brief: private function to set the pixels x0 to x1 of the absolute
+ *          line y, which is in the band, to bits. the bytes in between
+ *          are written whole, the two at the ends through a mask.
+ */
+void EPDPaint::fillSpan(int x0, int x1, int y, unsigned char bits) {
+  EPDShapes::fillSpan(&this->image[(y - this->bandY) * (this->width / 8)], x0, x1, bits);
+}
+
+/**
+ *  @brief: private function to draw a glyph of a font (see drawCharAt())
+ *          whose pixels all land inside the image, false otherwise.
+ *          a line of the glyph is read as one word. without rotation,
+ *          or upside down with the bits reversed, it is shifted into
+ *          place and merged into the image a byte at a time, and so are
+ *          the lines of a glyph turned by the glyph cache (see
+ *          setGlyphCache()). rotated by 90 or 270 degrees without it a
+ *          line of the glyph becomes a column of the image, which is
+ *          written with the same mask from line to line.
+ *          the pixels outside the band are left out, and the damage is
+ *          the one drawPixel() would leave.
+ */
+bool EPDPaint::blitChar(int x, int y, char ascii_char, sFONT* font, int colored) {
+  int glyph_width = font->Width;
+  int glyph_height = font->Height;
+  int line_bytes = glyph_width / 8 + (glyph_width % 8 ? 1 : 0);
+  const unsigned char* glyph = &font->table[(ascii_char - ' ') * glyph_height * line_bytes];
+  int stride = this->width / 8;
+  bool upright = this->rotate == ROTATE_0 || this->rotate == ROTATE_180;
+  int x_min = this->rotate == ROTATE_180 || this->rotate == ROTATE_270 ? 1 : 0;
+  int y_min = this->rotate == ROTATE_90 || this->rotate == ROTATE_180 ? 1 : 0;
+  bool set = IF_INVERT_COLOR ? colored : !colored;
+  int i_first = 0;
+  int i_last = glyph_width - 1;
+  int i0 = glyph_width;
+  int i1 = -1;
+  int j0 = glyph_height;
+  int j1 = -1;
+  uint32_t columns;
+
+  if (
+      glyph_width > 24 ||
+      x < x_min || x + glyph_width > (upright ? this->width : this->height) ||
+      y < y_min || y + glyph_height > (upright ? this->height : this->width)
+      ) {
+    return false;
+  }
+  columns = 0xFFFFFFFFUL << (32 - glyph_width);
+  if (upright) {
+    for (int j = 0; j < glyph_height; j++) {
+      uint32_t bits = EPDShapes::glyphLine(glyph, line_bytes, j) & columns;
+      if (this->rotate == ROTATE_0) {
+        blitLine(x, y + j, bits, set);
+      } else {
+        /* right to left: pixel i lands at width - x - i */
+        blitLine(this->width - x - glyph_width + 1, this->height - y - j, EPDShapes::reverseBits(bits) << (32 - glyph_width), set);
+      }
+    }
+    return true;
+  }
+  if (this->glyphCache != NULL && glyph_height <= 24) {
+    const unsigned char* lines = this->glyphCache->get(font, ascii_char, this->rotate);
+    if (lines != NULL) {
+      int ax = this->rotate == ROTATE_90 ? this->width - y - glyph_height + 1 : y;
+      int ay = this->rotate == ROTATE_90 ? x : this->height - x - glyph_width + 1;
+      int turned_bytes = glyph_height / 8 + (glyph_height % 8 ? 1 : 0);
+      for (int i = 0; i < glyph_width; i++) {
+        uint32_t bits = 0;
+        for (int k = 0; k < turned_bytes; k++) {
+          bits |= (uint32_t) lines[i * turned_bytes + k] << (24 - 8 * k);
+        }
+        blitLine(ax, ay + i, bits, set);
+      }
+      return true;
+    }
+  }
+  /* the columns of the glyph that land in the band */
+  if (this->rotate == ROTATE_90) {
+    i_first = this->bandY - x > 0 ? this->bandY - x : 0;
+    i_last = this->bandY + this->bandHeight - 1 - x < i_last ? this->bandY + this->bandHeight - 1 - x : i_last;
+  } else {
+    i_first = this->height - x - (this->bandY + this->bandHeight - 1) > 0 ?
+              this->height - x - (this->bandY + this->bandHeight - 1) : 0;
+    i_last = this->height - x - this->bandY < i_last ? this->height - x - this->bandY : i_last;
+  }
+  if (i_first > i_last) {
+    return true;
+  }
+  columns = (0xFFFFFFFFUL >> i_first) & ~(0xFFFFFFFFUL >> (i_last + 1));
+
+  for (int j = 0; j < glyph_height; j++) {
+    uint32_t bits = EPDShapes::glyphLine(glyph, line_bytes, j) & columns;
+    unsigned char* p;
+    int ax;
+    int ay;
+    int step;
+    if (bits == 0) {
+      continue;
+    }
+    /* the set pixels of the line, for the damage */
+    j0 = j0 < j ? j0 : j;
+    j1 = j;
+    for (int i = 0; i < i0; i++) {
+      if (bits & (0x80000000UL >> i)) {
+        i0 = i;
+      }
+    }
+    for (int i = glyph_width - 1; i > i1; i--) {
+      if (bits & (0x80000000UL >> i)) {
+        i1 = i;
+      }
+    }
+    ax = this->rotate == ROTATE_90 ? this->width - y - j : y + j;
+    ay = this->rotate == ROTATE_90 ? x + i_first : this->height - x - i_first;
+    step = this->rotate == ROTATE_90 ? stride : -stride;
+    p = &this->image[(ay - this->bandY) * stride + ax / 8];
+    EPDShapes::mergeColumn(p, step, 0x80 >> (ax % 8), bits, i_first, i_last, set);
+  }
+  if (j1 < 0) {
+    return true;
+  }
+  if (this->rotate == ROTATE_90) {
+    damage(this->width - y - j1, x + i0, this->width - y - j0, x + i1);
+  } else {
+    damage(y + j0, this->height - x - i1, y + j1, this->height - x - i0);
+  }
+  return true;
+}
+
+/**
+ *  @brief: private function to merge the pixels of bits, the first one
+ *          in the most significant bit, into the absolute line y from x
+ *          on. set sets them, otherwise they are cleared. a line outside
+ *          the band is left out.
+ */
+void EPDPaint::blitLine(int x, int y, uint32_t bits, bool set) {
+  int first = 0;
+  int last = 31;
+
+  if (bits == 0 || y < this->bandY || y >= this->bandY + this->bandHeight) {
+    return;
+  }
+  while (!(bits & (0x80000000UL >> first))) {
+    first++;
+  }
+  while (!(bits & (0x80000000UL >> last))) {
+    last--;
+  }
+  damage(x + first, y, x + last, y);
+  EPDShapes::mergeLine(&this->image[(y - this->bandY) * (this->width / 8)], x, bits, set);
+}
+
 /**
  *  @brief: Getters and Setters
  */
@@ -83,12 +330,17 @@ unsigned char* EPDPaint::getImage(void) {
   return this->image;
 }
 
+void EPDPaint::setImage(unsigned char* image) {
+  this->image = image;
+}
+
 int EPDPaint::getWidth(void) {
   return this->width;
 }
 
 void EPDPaint::setWidth(int width) {
   this->width = width % 8 ? width + 8 - (width % 8) : width;
+  clearDamage();
 }
 
 int EPDPaint::getHeight(void) {
@@ -97,6 +349,53 @@ int EPDPaint::getHeight(void) {
 
 void EPDPaint::setHeight(int height) {
   this->height = height;
+  this->bandY = 0;
+  this->bandHeight = height;
+  clearDamage();
+}
+
+/**
+ *  @brief: let the image hold only the rows y to y + height - 1 (in
+ *          absolute coordinates) of the paint, e.g. a strip of a frame
+ *          too large for the RAM. drawing still takes the coordinates of
+ *          the whole paint, the pixels outside the band are dropped.
+ *          the image has to be width / 8 * height bytes.
+ *          setHeight() makes the band the whole paint again.
+ */
+void EPDPaint::setBand(int y, int height) {
+  this->bandY = y;
+  this->bandHeight = height;
+}
+
+int EPDPaint::getBandY(void) {
+  return this->bandY;
+}
+
+int EPDPaint::getBandHeight(void) {
+  return this->bandHeight;
+}
+
+/**
+ *  @brief: true if a rectangle of the coordinates of drawPixel() (the
+ *          rotation applied) may cover a row of the band
+ */
+bool EPDPaint::bandIntersects(int x0, int y0, int x1, int y1) {
+  int y_start;
+  int y_end;
+  if (this->rotate == ROTATE_90) {
+    y_start = x0;
+    y_end = x1;
+  } else if (this->rotate == ROTATE_180) {
+    y_start = this->height - y1;
+    y_end = this->height - y0;
+  } else if (this->rotate == ROTATE_270) {
+    y_start = this->height - x1;
+    y_end = this->height - x0;
+  } else {
+    y_start = y0;
+    y_end = y1;
+  }
+  return y_start < this->bandY + this->bandHeight && y_end >= this->bandY;
 }
 
 int EPDPaint::getRotate(void) {
@@ -107,6 +406,19 @@ void EPDPaint::setRotate(int rotate){
   this->rotate = rotate;
 }
 
+/**
+ *  @brief: keep the glyphs turned for ROTATE_90 and ROTATE_270 in cache,
+ *          so rotated text is drawn a byte at a time as well.
+ *          NULL turns this off. a cache may be shared by several paints.
+ */
+void EPDPaint::setGlyphCache(EPDGlyphCache* cache) {
+  this->glyphCache = cache;
+}
+
+EPDGlyphCache* EPDPaint::getGlyphCache(void) {
+  return this->glyphCache;
+}
+
 /**
  *  @brief: this draws a pixel by the coordinates
  */
@@ -147,76 +459,33 @@ void EPDPaint::drawPixel(int x, int y, int colored) {
  *  @brief: this draws a charactor on the frame buffer but not refresh
  */
 void EPDPaint::drawCharAt(int x, int y, char ascii_char, sFONT* font, int colored) {
-  int i, j;
-  unsigned int char_offset = (ascii_char - ' ') * font->Height * (font->Width / 8 + (font->Width % 8 ? 1 : 0));
-  const unsigned char* ptr = &font->table[char_offset];
-
-  for (j = 0; j < font->Height; j++) {
-    for (i = 0; i < font->Width; i++) {
-      if (pgm_read_byte(ptr) & (0x80 >> (i % 8))) {
-        drawPixel(x + i, y + j, colored);
-      }
-      if (i % 8 == 7) {
-        ptr++;
-      }
-    }
-    if (font->Width % 8 != 0) {
-      ptr++;
-    }
+  if (blitChar(x, y, ascii_char, font, colored)) {
+    return;
   }
+  /* a character cut by the edge of the image, pixel by pixel */
+  EPDShapes::drawCharAt(*this, x, y, ascii_char, font, colored);
 }
 
 /**
  *  @brief: this displays a string on the frame buffer but not refresh
  */
 void EPDPaint::drawStringAt(int x, int y, const char* text, sFONT* font, int colored) {
-  const char* p_text = text;
-  unsigned int counter = 0;
-  int refcolumn = x;
-
-  /* Send the string character by character on EPD */
-  while (*p_text != 0) {
-    /* Display one character on EPD */
-    drawCharAt(refcolumn, y, *p_text, font, colored);
-    /* Decrement the column position by 16 */
-    refcolumn += font->Width;
-    /* Point on the next character */
-    p_text++;
-    counter++;
-  }
+  EPDShapes::drawStringAt(*this, x, y, text, font, colored);
 }
 
 /**
  *  @brief: this draws a line on the frame buffer
  */
 void EPDPaint::drawLine(int x0, int y0, int x1, int y1, int colored) {
-  /* Bresenham algorithm */
-  int dx = x1 - x0 >= 0 ? x1 - x0 : x0 - x1;
-  int sx = x0 < x1 ? 1 : -1;
-  int dy = y1 - y0 <= 0 ? y1 - y0 : y0 - y1;
-  int sy = y0 < y1 ? 1 : -1;
-  int err = dx + dy;
-
-  while((x0 != x1) && (y0 != y1)) {
-    drawPixel(x0, y0 , colored);
-    if (2 * err >= dy) {
-      err += dy;
-      x0 += sx;
-    }
-    if (2 * err <= dx) {
-      err += dx;
-      y0 += sy;
-    }
-  }
+  EPDShapes::drawLine(*this, x0, y0, x1, y1, colored);
 }
 
 /**
  *  @brief: this draws a horizontal line on the frame buffer
  */
 void EPDPaint::drawHorizontalLine(int x, int y, int line_width, int colored) {
-  int i;
-  for (i = x; i < x + line_width; i++) {
-    drawPixel(i, y, colored);
+  if (line_width > 0) {
+    fillRegion(x, y, x + line_width - 1, y, colored);
   }
 }
 
@@ -224,9 +493,8 @@ void EPDPaint::drawHorizontalLine(int x, int y, int line_width, int colored) {
  *  @brief: this draws a vertical line on the frame buffer
  */
 void EPDPaint::drawVerticalLine(int x, int y, int line_height, int colored) {
-  int i;
-  for (i = y; i < y + line_height; i++) {
-    drawPixel(x, i, colored);
+  if (line_height > 0) {
+    fillRegion(x, y, x, y + line_height - 1, colored);
   }
 }
 
@@ -234,90 +502,100 @@ void EPDPaint::drawVerticalLine(int x, int y, int line_height, int colored) {
  *  @brief: this draws a rectangle
  */
 void EPDPaint::drawRectangle(int x0, int y0, int x1, int y1, int colored) {
-  int min_x, min_y, max_x, max_y;
-  min_x = x1 > x0 ? x0 : x1;
-  max_x = x1 > x0 ? x1 : x0;
-  min_y = y1 > y0 ? y0 : y1;
-  max_y = y1 > y0 ? y1 : y0;
-
-  drawHorizontalLine(min_x, min_y, max_x - min_x + 1, colored);
-  drawHorizontalLine(min_x, max_y, max_x - min_x + 1, colored);
-  drawVerticalLine(min_x, min_y, max_y - min_y + 1, colored);
-  drawVerticalLine(max_x, min_y, max_y - min_y + 1, colored);
+  EPDShapes::drawRectangle(*this, x0, y0, x1, y1, colored);
 }
 
 /**
  *  @brief: this draws a filled rectangle
  */
 void EPDPaint::drawFilledRectangle(int x0, int y0, int x1, int y1, int colored) {
-  int min_x, min_y, max_x, max_y;
-  int i;
-  min_x = x1 > x0 ? x0 : x1;
-  max_x = x1 > x0 ? x1 : x0;
-  min_y = y1 > y0 ? y0 : y1;
-  max_y = y1 > y0 ? y1 : y0;
-
-  for (i = min_x; i <= max_x; i++) {
-    drawVerticalLine(i, min_y, max_y - min_y + 1, colored);
-  }
+  fillRegion(x0, y0, x1, y1, colored);
 }
 
 /**
  *  @brief: this draws a circle
  */
 void EPDPaint::drawCircle(int x, int y, int radius, int colored) {
-  /* Bresenham algorithm */
-  int x_pos = -radius;
-  int y_pos = 0;
-  int err = 2 - 2 * radius;
-  int e2;
-
-  do {
-    drawPixel(x - x_pos, y + y_pos, colored);
-    drawPixel(x + x_pos, y + y_pos, colored);
-    drawPixel(x + x_pos, y - y_pos, colored);
-    drawPixel(x - x_pos, y - y_pos, colored);
-    e2 = err;
-    if (e2 <= y_pos) {
-      err += ++y_pos * 2 + 1;
-      if(-x_pos == y_pos && e2 <= x_pos) {
-        e2 = 0;
-      }
-    }
-    if (e2 > x_pos) {
-      err += ++x_pos * 2 + 1;
-    }
-  } while (x_pos <= 0);
+  EPDShapes::drawCircle(*this, x, y, radius, colored, false);
 }
 
 /**
  *  @brief: this draws a filled circle
  */
 void EPDPaint::drawFilledCircle(int x, int y, int radius, int colored) {
-  /* Bresenham algorithm */
-  int x_pos = -radius;
-  int y_pos = 0;
-  int err = 2 - 2 * radius;
-  int e2;
-
-  do {
-    drawPixel(x - x_pos, y + y_pos, colored);
-    drawPixel(x + x_pos, y + y_pos, colored);
-    drawPixel(x + x_pos, y - y_pos, colored);
-    drawPixel(x - x_pos, y - y_pos, colored);
-    drawHorizontalLine(x + x_pos, y + y_pos, 2 * (-x_pos) + 1, colored);
-    drawHorizontalLine(x + x_pos, y - y_pos, 2 * (-x_pos) + 1, colored);
-    e2 = err;
-    if (e2 <= y_pos) {
-      err += ++y_pos * 2 + 1;
-      if(-x_pos == y_pos && e2 <= x_pos) {
-        e2 = 0;
+  EPDShapes::drawCircle(*this, x, y, radius, colored, true);
+}
+
+/**
+ *  @brief: this draws a bitmap in the flash, 1 bit per pixel with the
+ *          most significant bit first and every line starting with a new
+ *          byte, like the characters of a font.
+ *          only the set bits are drawn.
+ */
+void EPDPaint::drawBitmapAt(int x, int y, const unsigned char* bitmap, int bitmap_width, int bitmap_height, int colored) {
+  int line_bytes = bitmap_width / 8 + (bitmap_width % 8 ? 1 : 0);
+  int i, j;
+
+  for (j = 0; j < bitmap_height; j++) {
+    const unsigned char* ptr = &bitmap[j * line_bytes];
+    for (i = 0; i < bitmap_width; i++) {
+      if (pgm_read_byte(&ptr[i / 8]) & (0x80 >> (i % 8))) {
+        drawPixel(x + i, y + j, colored);
       }
     }
-    if(e2 > x_pos) {
-      err += ++x_pos * 2 + 1;
-    }
-  } while(x_pos <= 0);
+  }
+}
+
+/**
+ *  @brief: the damage is the rectangle around every pixel drawn since
+ *          the last clearDamage(), in absolute coordinates (the rotation
+ *          applied), see EPD1in54::setFrameMemoryDamage().
+ *          setWidth() and setHeight() clear it.
+ */
+bool EPDPaint::hasDamage(void) {
+  return this->damageX0 <= this->damageX1;
+}
+
+int EPDPaint::getDamageX(void) {
+  return hasDamage() ? this->damageX0 : 0;
+}
+
+int EPDPaint::getDamageY(void) {
+  return hasDamage() ? this->damageY0 : 0;
+}
+
+int EPDPaint::getDamageWidth(void) {
+  return hasDamage() ? this->damageX1 - this->damageX0 + 1 : 0;
+}
+
+int EPDPaint::getDamageHeight(void) {
+  return hasDamage() ? this->damageY1 - this->damageY0 + 1 : 0;
+}
+
+void EPDPaint::clearDamage(void) {
+  this->damageX0 = 0x7FFF;
+  this->damageY0 = 0x7FFF;
+  this->damageX1 = -1;
+  this->damageY1 = -1;
+}
+
+/**
+ *  @brief: private function to grow the damage by a rectangle of
+ *          absolute coordinates
+ */
+void EPDPaint::damage(int x0, int y0, int x1, int y1) {
+  if (x0 < this->damageX0) {
+    this->damageX0 = x0;
+  }
+  if (y0 < this->damageY0) {
+    this->damageY0 = y0;
+  }
+  if (x1 > this->damageX1) {
+    this->damageX1 = x1;
+  }
+  if (y1 > this->damageY1) {
+    this->damageY1 = y1;
+  }
 }
 
 /* END OF FILE */
@@ -36,20 +36,32 @@
 // Color inverse. 1 or 0 = set or reset a bit if set a colored pixel
 #define IF_INVERT_COLOR     1
 
+#include <stdint.h>
 #include "fonts.h"
 
+class EPDGlyphCache;
+
 class EPDPaint {
  public:
   EPDPaint(unsigned char* image, int width, int height);
   ~EPDPaint();
   void clear(int colored);
+  void fillRegion(int x0, int y0, int x1, int y1, int colored);
+  void fillPattern(const unsigned char* pattern);
   int  getWidth(void);
   void setWidth(int width);
   int  getHeight(void);
   void setHeight(int height);
+  void setBand(int y, int height);
+  int  getBandY(void);
+  int  getBandHeight(void);
+  bool bandIntersects(int x0, int y0, int x1, int y1);
   int  getRotate(void);
   void setRotate(int rotate);
+  void setGlyphCache(EPDGlyphCache* cache);
+  EPDGlyphCache* getGlyphCache(void);
   unsigned char* getImage(void);
+  void setImage(unsigned char* image);
   void drawAbsolutePixel(int x, int y, int colored);
   void drawPixel(int x, int y, int colored);
   void drawCharAt(int x, int y, char ascii_char, sFONT* font, int colored);
@@ -61,12 +73,33 @@ class EPDPaint {
   void drawFilledRectangle(int x0, int y0, int x1, int y1, int colored);
   void drawCircle(int x, int y, int radius, int colored);
   void drawFilledCircle(int x, int y, int radius, int colored);
+  void drawBitmapAt(int x, int y, const unsigned char* bitmap, int bitmap_width, int bitmap_height, int colored);
+  bool hasDamage(void);
+  int  getDamageX(void);
+  int  getDamageY(void);
+  int  getDamageWidth(void);
+  int  getDamageHeight(void);
+  void clearDamage(void);
 
  private:
   unsigned char* image;
   int width;
   int height;
   int rotate;
+  int bandY;
+  int bandHeight;
+  EPDGlyphCache* glyphCache;
+  int damageX0;
+  int damageY0;
+  int damageX1;
+  int damageY1;
+
+  void damage(int x0, int y0, int x1, int y1);
+  unsigned char colorBits(int colored);
+  void fillAbsolute(int x0, int y0, int x1, int y1, unsigned char bits, const unsigned char* pattern);
+  void fillSpan(int x0, int x1, int y, unsigned char bits);
+  bool blitChar(int x, int y, char ascii_char, sFONT* font, int colored);
+  void blitLine(int x, int y, uint32_t bits, bool set);
 };
 
 #endif
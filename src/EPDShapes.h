@@ -0,0 +1,227 @@
+/**
+ *  @filename   :   EPDShapes.h
+ *  @brief      :   Drawing code shared by EPDPaint and EPDFixedPaint
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef EPDSHAPES_H
+#define EPDSHAPES_H
+
+#if defined(__AVR__) || defined(ARDUINO_ARCH_SAMD)
+#include <avr/pgmspace.h>
+#elif defined(ESP8266) || defined(ESP32) || defined(EPD_HOST)
+#include <pgmspace.h>
+#endif
+#include <stdint.h>
+#include <string.h>
+#include "fonts.h"
+
+/**
+ *  the shapes built from the pixels, lines and fills of a paint, and the
+ *  bit operations of the glyph blitters, written once for EPDPaint and
+ *  EPDFixedPaint so that both draw the same pixels. PAINT provides
+ *  drawPixel(), drawHorizontalLine() and drawVerticalLine().
+ */
+class EPDShapes {
+ public:
+  /**
+   *  @brief: a charactor, pixel by pixel
+   */
+  template <class PAINT>
+  static void drawCharAt(PAINT& paint, int x, int y, char ascii_char, sFONT* font, int colored) {
+    int i, j;
+    unsigned int char_offset = (ascii_char - ' ') * font->Height * (font->Width / 8 + (font->Width % 8 ? 1 : 0));
+    const unsigned char* ptr = &font->table[char_offset];
+
+    for (j = 0; j < font->Height; j++) {
+      for (i = 0; i < font->Width; i++) {
+        if (pgm_read_byte(ptr) & (0x80 >> (i % 8))) {
+          paint.drawPixel(x + i, y + j, colored);
+        }
+        if (i % 8 == 7) {
+          ptr++;
+        }
+      }
+      if (font->Width % 8 != 0) {
+        ptr++;
+      }
+    }
+  }
+
+  template <class PAINT>
+  static void drawStringAt(PAINT& paint, int x, int y, const char* text, sFONT* font, int colored) {
+    /* Send the string character by character on EPD */
+    for (; *text != 0; text++) {
+      paint.drawCharAt(x, y, *text, font, colored);
+      x += font->Width;
+    }
+  }
+
+  template <class PAINT>
+  static void drawLine(PAINT& paint, int x0, int y0, int x1, int y1, int colored) {
+    /* Bresenham algorithm */
+    int dx = x1 - x0 >= 0 ? x1 - x0 : x0 - x1;
+    int sx = x0 < x1 ? 1 : -1;
+    int dy = y1 - y0 <= 0 ? y1 - y0 : y0 - y1;
+    int sy = y0 < y1 ? 1 : -1;
+    int err = dx + dy;
+
+    while ((x0 != x1) && (y0 != y1)) {
+      paint.drawPixel(x0, y0, colored);
+      if (2 * err >= dy) {
+        err += dy;
+        x0 += sx;
+      }
+      if (2 * err <= dx) {
+        err += dx;
+        y0 += sy;
+      }
+    }
+  }
+
+  template <class PAINT>
+  static void drawRectangle(PAINT& paint, int x0, int y0, int x1, int y1, int colored) {
+    int min_x = x1 > x0 ? x0 : x1;
+    int max_x = x1 > x0 ? x1 : x0;
+    int min_y = y1 > y0 ? y0 : y1;
+    int max_y = y1 > y0 ? y1 : y0;
+
+    paint.drawHorizontalLine(min_x, min_y, max_x - min_x + 1, colored);
+    paint.drawHorizontalLine(min_x, max_y, max_x - min_x + 1, colored);
+    paint.drawVerticalLine(min_x, min_y, max_y - min_y + 1, colored);
+    paint.drawVerticalLine(max_x, min_y, max_y - min_y + 1, colored);
+  }
+
+  /**
+   *  @brief: a circle, or a filled one drawn with a line across every
+   *          row as well
+   */
+  template <class PAINT>
+  static void drawCircle(PAINT& paint, int x, int y, int radius, int colored, bool filled) {
+    /* Bresenham algorithm */
+    int x_pos = -radius;
+    int y_pos = 0;
+    int err = 2 - 2 * radius;
+    int e2;
+
+    do {
+      paint.drawPixel(x - x_pos, y + y_pos, colored);
+      paint.drawPixel(x + x_pos, y + y_pos, colored);
+      paint.drawPixel(x + x_pos, y - y_pos, colored);
+      paint.drawPixel(x - x_pos, y - y_pos, colored);
+      if (filled) {
+        paint.drawHorizontalLine(x + x_pos, y + y_pos, 2 * (-x_pos) + 1, colored);
+        paint.drawHorizontalLine(x + x_pos, y - y_pos, 2 * (-x_pos) + 1, colored);
+      }
+      e2 = err;
+      if (e2 <= y_pos) {
+        err += ++y_pos * 2 + 1;
+        if (-x_pos == y_pos && e2 <= x_pos) {
+          e2 = 0;
+        }
+      }
+      if (e2 > x_pos) {
+        err += ++x_pos * 2 + 1;
+      }
+    } while (x_pos <= 0);
+  }
+
+  /**
+   *  @brief: set the pixels x0 to x1 of line to bits. the bytes in
+   *          between are written whole, the two at the ends through a mask.
+   */
+  static void fillSpan(unsigned char* line, int x0, int x1, unsigned char bits) {
+    int first = x0 / 8;
+    int last = x1 / 8;
+    unsigned char first_mask = 0xFF >> (x0 % 8);
+    unsigned char last_mask = 0xFF << (7 - x1 % 8);
+
+    if (first == last) {
+      first_mask &= last_mask;
+      line[first] = (line[first] & ~first_mask) | (bits & first_mask);
+      return;
+    }
+    line[first] = (line[first] & ~first_mask) | (bits & first_mask);
+    memset(&line[first + 1], bits, last - first - 1);
+    line[last] = (line[last] & ~last_mask) | (bits & last_mask);
+  }
+
+  /**
+   *  @brief: line j of a glyph of line_bytes bytes a line in the flash,
+   *          the first pixel in the most significant bit
+   */
+  static uint32_t glyphLine(const unsigned char* glyph, int line_bytes, int j) {
+    uint32_t bits = 0;
+    for (int k = 0; k < line_bytes; k++) {
+      bits |= (uint32_t) pgm_read_byte(&glyph[j * line_bytes + k]) << (24 - 8 * k);
+    }
+    return bits;
+  }
+
+  /**
+   *  @brief: a 32 bit word with the bits in the opposite order
+   */
+  static uint32_t reverseBits(uint32_t bits) {
+    bits = ((bits >> 1) & 0x55555555UL) | ((bits & 0x55555555UL) << 1);
+    bits = ((bits >> 2) & 0x33333333UL) | ((bits & 0x33333333UL) << 2);
+    bits = ((bits >> 4) & 0x0F0F0F0FUL) | ((bits & 0x0F0F0F0FUL) << 4);
+    bits = ((bits >> 8) & 0x00FF00FFUL) | ((bits & 0x00FF00FFUL) << 8);
+    return (bits >> 16) | (bits << 16);
+  }
+
+  /**
+   *  @brief: merge the pixels of bits, the first one in the most
+   *          significant bit, into line from x on, a byte at a time.
+   *          set sets them, otherwise they are cleared.
+   */
+  static void mergeLine(unsigned char* line, int x, uint32_t bits, bool set) {
+    bits >>= x % 8;
+    for (int k = x / 8; bits != 0; k++) {
+      unsigned char byte = bits >> 24;
+      if (set) {
+        line[k] |= byte;
+      } else {
+        line[k] &= ~byte;
+      }
+      bits <<= 8;
+    }
+  }
+
+  /**
+   *  @brief: merge the pixels i_first to i_last of bits into a column,
+   *          from the byte at p on, step bytes from pixel to pixel
+   */
+  static void mergeColumn(unsigned char* p, int step, unsigned char mask, uint32_t bits, int i_first, int i_last, bool set) {
+    for (int i = i_first; i <= i_last; i++) {
+      if (bits & (0x80000000UL >> i)) {
+        if (set) {
+          *p |= mask;
+        } else {
+          *p &= ~mask;
+        }
+      }
+      p += step;
+    }
+  }
+};
+
+#endif
+
+/* END OF FILE */
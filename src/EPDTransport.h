@@ -0,0 +1,306 @@
+/**
+ *  @filename   :   EPDTransport.h
+ *  @brief      :   Transport policies used by EPDIF to reach the module.
+ *                  EPDIF holds one EPD_TRANSPORT object and calls it directly, so the
+ *                  calls are resolved and inlined at compile time.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef EPDTRANSPORT_H
+#define EPDTRANSPORT_H
+
+#include <Arduino.h>
+#include <SPI.h>
+#if defined(EPD_HOST)
+#include <EPDHost.h>
+#endif
+
+// Size of the stack buffer used to stage burst transfers
+#define EPDIF_CHUNK_SIZE    32
+
+// BUSY waits, see EPDTransportPins::waitBusy()
+#define EPD_WAIT_FOREVER            0
+#define EPD_BUSY_POLL_US            500
+#define EPD_BUSY_EDGE_TIMEOUT_MS    10
+
+/* called when an asynchronous transfer has been pushed out completely */
+typedef void (*EPDTransferCallback)(void* arg);
+
+/**
+ *  A transport provides:
+ *    int  begin(reset, dc, cs, busy, clock)   set up the pins and the bus,
+ *                                             0 on success
+ *    void setClock(clock)                     change the bus clock
+ *    void writeReset(level), writeDc(level)   drive the RESET and DC pins
+ *    void select(), deselect()                drive the CS pin
+ *    int  readBusy()                          read the BUSY pin
+ *    bool waitBusy(level, timeout_ms)         wait for the BUSY pin to
+ *                                             read level, false on timeout,
+ *                                             EPD_WAIT_FOREVER: no timeout
+ *    void transfer(data)                      send one byte
+ *    void write(data, len)                    send a block, data untouched
+ *    void writeStaged(buf, len)               send a block, buf may be
+ *                                             overwritten
+ *    int  writeAsync(data, len, done, arg)    start a block in the
+ *                                             background, -1 if the
+ *                                             transport can not
+ *    void finishAsync()                       wait for that block
+ *    bool takeWriteError()                    true once after a block the
+ *                                             bus failed to send
+ *    void delayMs(ms), unsigned long nowMs()  timing
+ */
+
+/**
+ *  RESET, DC, CS and BUSY on Arduino pins, shared by the Arduino transports.
+ *  waitBusy() sleeps until an edge interrupt on ESP32 and polls every
+ *  EPD_BUSY_POLL_US elsewhere.
+ */
+class EPDTransportPins {
+ public:
+#if defined(ESP32)
+  EPDTransportPins(void) : busySignal(NULL) {
+  }
+
+  ~EPDTransportPins(void) {
+    if (busySignal != NULL) {
+      vSemaphoreDelete(busySignal);
+    }
+  }
+#endif
+
+  void beginPins(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy) {
+    resetPin = reset;
+    dcPin = dc;
+    csPin = cs;
+    busyPin = busy;
+    pinMode(csPin, OUTPUT);
+    pinMode(resetPin, OUTPUT);
+    pinMode(dcPin, OUTPUT);
+    pinMode(busyPin, INPUT);
+  }
+
+  void writeReset(int level) {
+    digitalWrite(resetPin, level);
+  }
+
+  void writeDc(int level) {
+    digitalWrite(dcPin, level);
+  }
+
+  void select(void) {
+    digitalWrite(csPin, LOW);
+  }
+
+  void deselect(void) {
+    digitalWrite(csPin, HIGH);
+  }
+
+  int readBusy(void) {
+    return digitalRead(busyPin);
+  }
+
+  /* the Arduino SPI API reports no errors */
+  bool takeWriteError(void) {
+    return false;
+  }
+
+  bool waitBusy(int level, unsigned long timeout_ms) {
+    unsigned long start = millis();
+    bool reached = true;
+#if defined(ESP32)
+    if (digitalRead(busyPin) == level) {
+      return true;
+    }
+    if (busySignal == NULL) {
+      busySignal = xSemaphoreCreateBinary();
+    }
+    if (busySignal != NULL) {
+      /* an edge after the last wait may have left it given */
+      xSemaphoreTake(busySignal, 0);
+      attachInterruptArg(digitalPinToInterrupt(busyPin), busyEdge, this, CHANGE);
+    }
+#endif
+    while (digitalRead(busyPin) != level) {
+      if (timeout_ms != EPD_WAIT_FOREVER && millis() - start >= timeout_ms) {
+        reached = false;
+        break;
+      }
+#if defined(ESP32)
+      if (busySignal != NULL) {
+        /* the interrupt gives busySignal, the timeout covers a missed edge */
+        xSemaphoreTake(busySignal, pdMS_TO_TICKS(EPD_BUSY_EDGE_TIMEOUT_MS));
+        continue;
+      }
+#endif
+      delayMicroseconds(EPD_BUSY_POLL_US);
+    }
+#if defined(ESP32)
+    if (busySignal != NULL) {
+      detachInterrupt(digitalPinToInterrupt(busyPin));
+    }
+#endif
+    return reached;
+  }
+
+  void delayMs(unsigned int ms) {
+    delay(ms);
+  }
+
+  unsigned long nowMs(void) {
+    return millis();
+  }
+
+ private:
+  unsigned int resetPin;
+  unsigned int dcPin;
+  unsigned int csPin;
+  unsigned int busyPin;
+#if defined(ESP32)
+  /* given by the BUSY interrupt, kept apart from the task notification
+     the application may use */
+  SemaphoreHandle_t busySignal;
+
+  static void IRAM_ATTR busyEdge(void* arg) {
+    BaseType_t woken = pdFALSE;
+    xSemaphoreGiveFromISR(((EPDTransportPins*) arg)->busySignal, &woken);
+    if (woken == pdTRUE) {
+      portYIELD_FROM_ISR();
+    }
+  }
+#endif
+};
+
+/**
+ *  hardware SPI through a given SPIClass object, e.g.
+ *  EPDTransportSPIBus<SPI1> for the second bus of a board
+ */
+template <SPIClass& bus>
+class EPDTransportSPIBus : public EPDTransportPins {
+ public:
+  int begin(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy, unsigned long clock) {
+    beginPins(reset, dc, cs, busy);
+    bus.beginTransaction(SPISettings(clock, MSBFIRST, SPI_MODE0));
+    bus.begin();
+    return 0;
+  }
+
+  void setClock(unsigned long clock) {
+    bus.endTransaction();
+    bus.beginTransaction(SPISettings(clock, MSBFIRST, SPI_MODE0));
+  }
+
+  void transfer(unsigned char data) {
+    bus.transfer(data);
+  }
+
+  /* SPIClass::transfer(buf, len) overwrites its buffer with the received
+     bytes, so the data is staged through a small stack buffer unless the
+     core offers a write-only burst */
+  void write(const unsigned char* data, unsigned int len) {
+#if defined(ESP8266) || defined(ESP32)
+    bus.writeBytes((const uint8_t*) data, len);
+#else
+    unsigned char chunk[EPDIF_CHUNK_SIZE];
+    while (len > 0) {
+      unsigned int count = len < EPDIF_CHUNK_SIZE ? len : EPDIF_CHUNK_SIZE;
+      memcpy(chunk, data, count);
+      bus.transfer(chunk, count);
+      data += count;
+      len -= count;
+    }
+#endif
+  }
+
+  void writeStaged(unsigned char* buf, unsigned int len) {
+    bus.transfer(buf, len);
+  }
+
+  int writeAsync(const unsigned char* data, unsigned int len, EPDTransferCallback done, void* arg) {
+#if defined(EPD_HOST)
+    EPDHost::queueDma(data, len, done, arg);
+    return 0;
+#else
+    return -1;
+#endif
+  }
+
+  void finishAsync(void) {
+#if defined(EPD_HOST)
+    EPDHost::finishDma();
+#endif
+  }
+};
+
+/* hardware SPI through the global SPI object, the default transport */
+typedef EPDTransportSPIBus<SPI> EPDTransportSPI;
+
+/**
+ *  bit-banged SPI mode 0 on any two pins, for boards whose SPI pins are
+ *  taken. the clock setting is ignored, the bus runs as fast as the
+ *  pins can be toggled.
+ */
+template <unsigned int MOSI_PIN, unsigned int SCK_PIN>
+class EPDTransportSoftSPI : public EPDTransportPins {
+ public:
+  int begin(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy, unsigned long) {
+    beginPins(reset, dc, cs, busy);
+    pinMode(MOSI_PIN, OUTPUT);
+    pinMode(SCK_PIN, OUTPUT);
+    digitalWrite(SCK_PIN, LOW);
+    return 0;
+  }
+
+  void setClock(unsigned long) {
+  }
+
+  void transfer(unsigned char data) {
+    for (int bit = 0; bit < 8; bit++) {
+      digitalWrite(MOSI_PIN, (data & 0x80) ? HIGH : LOW);
+      digitalWrite(SCK_PIN, HIGH);
+      digitalWrite(SCK_PIN, LOW);
+      data <<= 1;
+    }
+  }
+
+  void write(const unsigned char* data, unsigned int len) {
+    for (unsigned int i = 0; i < len; i++) {
+      transfer(data[i]);
+    }
+  }
+
+  void writeStaged(unsigned char* buf, unsigned int len) {
+    write(buf, len);
+  }
+
+  int writeAsync(const unsigned char*, unsigned int, EPDTransferCallback, void*) {
+    return -1;
+  }
+
+  void finishAsync(void) {
+  }
+};
+
+#if defined(__linux__) && !defined(ARDUINO)
+#include "EPDTransportLinux.h"
+#endif
+
+#endif
+
+/* END OF FILE */
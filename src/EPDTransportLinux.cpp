@@ -0,0 +1,287 @@
+/**
+ *  @filename   :   EPDTransportLinux.cpp
+ *  @brief      :   Implements the Linux spidev and GPIO character device transport
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#if defined(__linux__) && !defined(ARDUINO)
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include <linux/spi/spidev.h>
+#include "EPDTransport.h"
+
+// Index of the output lines in their request
+#define LINE_RESET      0
+#define LINE_DC         1
+#define LINE_CS         2
+
+EPDTransportLinux::EPDTransportLinux() {
+  spiDevice = EPD_LINUX_SPI_DEVICE;
+  gpioChip = EPD_LINUX_GPIO_CHIP;
+  spiFd = -1;
+  outputFd = -1;
+  busyFd = -1;
+  spiClock = 0;
+  kernelCs = false;
+  writeError = false;
+}
+
+EPDTransportLinux::~EPDTransportLinux() {
+  close();
+}
+
+/**
+ *  @brief: choose the spidev and gpiochip devices, call before init()
+ */
+void EPDTransportLinux::setDevices(const char* spi_device, const char* gpio_chip) {
+  spiDevice = spi_device;
+  gpioChip = gpio_chip;
+}
+
+int EPDTransportLinux::begin(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy, unsigned long clock) {
+  unsigned char mode = SPI_MODE_0;
+  unsigned char bits = 8;
+  struct gpio_v2_line_request request;
+  uint32_t speed;
+  int chip_fd;
+
+  close();
+  writeError = false;
+  kernelCs = cs == EPD_LINUX_KERNEL_CS;
+  spiClock = clock;
+  /* the kernel takes the clock as a 32 bit word */
+  speed = clock;
+  spiFd = open(spiDevice, O_RDWR | O_CLOEXEC);
+  if (
+      spiFd < 0 ||
+      ioctl(spiFd, SPI_IOC_WR_MODE, &mode) < 0 ||
+      ioctl(spiFd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+      ioctl(spiFd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0
+      ) {
+    close();
+    return -1;
+  }
+
+  chip_fd = open(gpioChip, O_RDWR | O_CLOEXEC);
+  if (chip_fd < 0) {
+    close();
+    return -1;
+  }
+  memset(&request, 0, sizeof(request));
+  request.offsets[LINE_RESET] = reset;
+  request.offsets[LINE_DC] = dc;
+  request.offsets[LINE_CS] = cs;
+  request.num_lines = kernelCs ? 2 : 3;
+  request.config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+  /* start with RESET, DC and CS high */
+  request.config.num_attrs = 1;
+  request.config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+  request.config.attrs[0].attr.values = 0x7;
+  request.config.attrs[0].mask = 0x7;
+  strncpy(request.consumer, "EPD", sizeof(request.consumer) - 1);
+  if (ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+    ::close(chip_fd);
+    close();
+    return -1;
+  }
+  outputFd = request.fd;
+
+  memset(&request, 0, sizeof(request));
+  request.offsets[0] = busy;
+  request.num_lines = 1;
+  request.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+  strncpy(request.consumer, "EPD busy", sizeof(request.consumer) - 1);
+  if (ioctl(chip_fd, GPIO_V2_GET_LINE_IOCTL, &request) < 0) {
+    ::close(chip_fd);
+    close();
+    return -1;
+  }
+  busyFd = request.fd;
+  ::close(chip_fd);
+  return 0;
+}
+
+void EPDTransportLinux::setClock(unsigned long clock) {
+  uint32_t speed = clock;
+  spiClock = clock;
+  if (spiFd >= 0) {
+    ioctl(spiFd, SPI_IOC_WR_MAX_SPEED_HZ, &speed);
+  }
+}
+
+void EPDTransportLinux::writeReset(int level) {
+  writeLine(LINE_RESET, level);
+}
+
+void EPDTransportLinux::writeDc(int level) {
+  writeLine(LINE_DC, level);
+}
+
+void EPDTransportLinux::select(void) {
+  if (!kernelCs) {
+    writeLine(LINE_CS, 0);
+  }
+}
+
+void EPDTransportLinux::deselect(void) {
+  if (!kernelCs) {
+    writeLine(LINE_CS, 1);
+  }
+}
+
+int EPDTransportLinux::readBusy(void) {
+  struct gpio_v2_line_values values;
+  values.bits = 0;
+  values.mask = 1;
+  if (busyFd < 0 || ioctl(busyFd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) {
+    return -1;
+  }
+  return (int) (values.bits & 1);
+}
+
+/**
+ *  @brief: sleep in poll() until an edge on BUSY, then read it again.
+ *          an edge that comes between the read and poll() is queued by
+ *          the kernel, so it can not be missed. false when BUSY can not
+ *          be read, even without a timeout.
+ */
+bool EPDTransportLinux::waitBusy(int level, unsigned long timeout_ms) {
+  struct gpio_v2_line_event events[16];
+  struct pollfd fds;
+  unsigned long start = nowMs();
+  unsigned long elapsed;
+  int busy;
+
+  while ((busy = readBusy()) != level) {
+    elapsed = nowMs() - start;
+    if (busy < 0 || (timeout_ms != EPD_WAIT_FOREVER && elapsed >= timeout_ms)) {
+      return false;
+    }
+    fds.fd = busyFd;
+    fds.events = POLLIN;
+    fds.revents = 0;
+    if (poll(&fds, 1, timeout_ms == EPD_WAIT_FOREVER ? -1 : (int) (timeout_ms - elapsed)) > 0) {
+      if (read(busyFd, events, sizeof(events)) < 0 && errno != EAGAIN) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+void EPDTransportLinux::transfer(unsigned char data) {
+  write(&data, 1);
+}
+
+void EPDTransportLinux::write(const unsigned char* data, unsigned int len) {
+  struct spi_ioc_transfer message;
+  while (len > 0) {
+    unsigned int count = len < EPD_LINUX_SPI_BUFSIZ ? len : EPD_LINUX_SPI_BUFSIZ;
+    memset(&message, 0, sizeof(message));
+    message.tx_buf = (uintptr_t) data;
+    message.len = count;
+    message.speed_hz = spiClock;
+    message.bits_per_word = 8;
+    if (ioctl(spiFd, SPI_IOC_MESSAGE(1), &message) < 0) {
+      writeError = true;
+      return;
+    }
+    data += count;
+    len -= count;
+  }
+}
+
+void EPDTransportLinux::writeStaged(unsigned char* buf, unsigned int len) {
+  write(buf, len);
+}
+
+/* spidev has no transfer in the background, the block goes by write() */
+int EPDTransportLinux::writeAsync(const unsigned char*, unsigned int, void (*)(void*), void*) {
+  return -1;
+}
+
+void EPDTransportLinux::finishAsync(void) {
+}
+
+/**
+ *  @brief: true if a block could not be sent since begin() or the last
+ *          call, see write()
+ */
+bool EPDTransportLinux::takeWriteError(void) {
+  bool error = writeError;
+  writeError = false;
+  return error;
+}
+
+void EPDTransportLinux::delayMs(unsigned int ms) {
+  struct timespec time;
+  time.tv_sec = ms / 1000;
+  time.tv_nsec = (long) (ms % 1000) * 1000000L;
+  while (nanosleep(&time, &time) < 0 && errno == EINTR) {
+  }
+}
+
+unsigned long EPDTransportLinux::nowMs(void) {
+  struct timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return (unsigned long) time.tv_sec * 1000UL + time.tv_nsec / 1000000L;
+}
+
+/**
+ *  @brief: private function to release the devices
+ */
+void EPDTransportLinux::close(void) {
+  if (spiFd >= 0) {
+    ::close(spiFd);
+    spiFd = -1;
+  }
+  if (outputFd >= 0) {
+    ::close(outputFd);
+    outputFd = -1;
+  }
+  if (busyFd >= 0) {
+    ::close(busyFd);
+    busyFd = -1;
+  }
+}
+
+/**
+ *  @brief: private function to drive one of the output lines
+ */
+void EPDTransportLinux::writeLine(int index, int level) {
+  struct gpio_v2_line_values values;
+  values.bits = level ? (1ULL << index) : 0;
+  values.mask = 1ULL << index;
+  if (outputFd >= 0) {
+    ioctl(outputFd, GPIO_V2_LINE_SET_VALUES_IOCTL, &values);
+  }
+}
+
+#endif
+
+/* END OF FILE */
@@ -0,0 +1,85 @@
+/**
+ *  @filename   :   EPDTransportLinux.h
+ *  @brief      :   Transport for Linux boards, using spidev and the GPIO character device.
+ *                  build with -DEPD_TRANSPORT=EPDTransportLinux, see README.md.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documnetation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to  whom the Software is
+ * furished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS OR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef EPDTRANSPORTLINUX_H
+#define EPDTRANSPORTLINUX_H
+
+// Default devices, see EPDTransportLinux::setDevices()
+#define EPD_LINUX_SPI_DEVICE    "/dev/spidev0.0"
+#define EPD_LINUX_GPIO_CHIP     "/dev/gpiochip0"
+
+// Give this as the cs pin to let the spidev driver handle the chip select
+#define EPD_LINUX_KERNEL_CS     0xFFFF
+
+// Largest single transfer, the bufsiz parameter of the spidev module
+#define EPD_LINUX_SPI_BUFSIZ    4096
+
+/**
+ *  The pins given to the driver are line offsets on the GPIO chip.
+ *  RESET, DC and CS are requested as one set of outputs, BUSY as an input
+ *  with edge events, so waitBusy() sleeps in poll() until BUSY changes.
+ *  Blocks are sent with SPI_IOC_MESSAGE, up to EPD_LINUX_SPI_BUFSIZ bytes
+ *  per ioctl. a failed ioctl drops the rest of the block and is kept for
+ *  takeWriteError(), which the drivers check in init() and displayFrame().
+ */
+class EPDTransportLinux {
+ public:
+  EPDTransportLinux();
+  ~EPDTransportLinux();
+  void setDevices(const char* spi_device, const char* gpio_chip);
+
+  int  begin(unsigned int reset, unsigned int dc, unsigned int cs, unsigned int busy, unsigned long clock);
+  void setClock(unsigned long clock);
+  void writeReset(int level);
+  void writeDc(int level);
+  void select(void);
+  void deselect(void);
+  int  readBusy(void);
+  bool waitBusy(int level, unsigned long timeout_ms);
+  void transfer(unsigned char data);
+  void write(const unsigned char* data, unsigned int len);
+  void writeStaged(unsigned char* buf, unsigned int len);
+  int  writeAsync(const unsigned char* data, unsigned int len, void (*done)(void*), void* arg);
+  void finishAsync(void);
+  bool takeWriteError(void);
+  void delayMs(unsigned int ms);
+  unsigned long nowMs(void);
+
+ private:
+  const char* spiDevice;
+  const char* gpioChip;
+  int spiFd;
+  int outputFd;
+  int busyFd;
+  unsigned long spiClock;
+  bool kernelCs;
+  bool writeError;
+
+  void close(void);
+  void writeLine(int index, int level);
+};
+
+#endif
+
+/* END OF FILE */